@@ -0,0 +1,142 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <random>
+#include <cstring>
+#include <cstdlib>
+#include <string_view>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "orasort_key.hpp"
+#include "orasort_profile.hpp"
+
+class LegrandSort {
+public:
+    // Sorts [first, last) by the keys proj projects from the elements (see
+    // orasort_key.hpp). Elements are swapped in place.
+    template <typename RandomIt, typename Proj = KeyIdentity>
+    static void sort(RandomIt first, RandomIt last, Proj proj = {}) {
+        static_assert(is_borrowed_key_v<projected_key_t<Proj, RandomIt>>,
+                      "LegrandSort keeps views of the keys: project to a reference, string_view or const char*");
+        if (last - first < 2) return;
+        sort_recursive(first, 0, static_cast<int>(last - first) - 1, 0, proj);
+    }
+
+    template <typename Range, typename Proj = KeyIdentity, typename = enable_if_range_t<Range>>
+    static void sort(Range& range, Proj proj = {}) {
+        sort(std::begin(range), std::end(range), proj);
+    }
+
+private:
+    template <typename RandomIt, typename Proj>
+    static std::string_view key(RandomIt arr, int i, Proj& proj) {
+        return key_view(std::invoke(proj, arr[i]));
+    }
+
+    template <typename RandomIt, typename Proj>
+    static int get_common_prefix(RandomIt arr, int low, int high, int depth, Proj& proj) {
+        if (low >= high) return 0;
+        const size_t start = static_cast<size_t>(depth);  // depth only grows from 0
+        
+        const std::string_view ref = key(arr, low, proj);
+        size_t min_common = std::string::npos;
+        
+        for (int i = low + 1; i <= high; ++i) {
+            const std::string_view curr = key(arr, i, proj);
+            size_t k = 0;
+            size_t max_k = std::min(ref.length(), curr.length());
+            
+            // Check bounds relative to depth
+            if (start >= max_k) {
+                // One string is exhausted at depth, common prefix beyond depth is 0
+                return 0;
+            }
+
+            size_t limit = max_k - start;
+            if (min_common != std::string::npos && min_common < limit) limit = min_common;
+            k = common_prefix_length(ref.data() + start, curr.data() + start, limit);
+            ORASORT_INSPECT(2 * std::min(k + 1, limit));
+            
+            if (min_common == std::string::npos || k < min_common) {
+                min_common = k;
+            }
+            
+            if (min_common == 0) return 0;
+        }
+        
+        return (min_common == std::string::npos) ? 0 : static_cast<int>(min_common);
+    }
+
+    // Number of equal leading bytes of a and b, at most limit.
+    // Compares 32 bytes per step when built with AVX2 (-mavx2, -march=native).
+    static size_t common_prefix_length(const char* a, const char* b, size_t limit) {
+        size_t k = 0;
+#ifdef __AVX2__
+        for (; k + 32 <= limit; k += 32) {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + k));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + k));
+            unsigned eq = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+            if (eq != 0xFFFFFFFFu) return k + __builtin_ctz(~eq);
+        }
+#endif
+        while (k < limit && a[k] == b[k]) k++;
+        return k;
+    }
+
+    static int compare_skip(std::string_view s1, std::string_view s2, int depth) {
+        // Safe string comparison skipping first 'depth' characters
+        // If depth exceeds length, it's effectively empty string comparison logic
+        const std::string_view p1 = s1.substr(std::min<size_t>(depth, s1.length()));
+        const std::string_view p2 = s2.substr(std::min<size_t>(depth, s2.length()));
+        ORASORT_COMPARE(1);
+#ifdef ORASORT_BYTE_STATS
+        size_t k = 0;
+        while (k < p1.length() && k < p2.length() && p1[k] == p2[k]) k++;
+        ORASORT_INSPECT(2 * (k + 1));
+#endif
+        return p1.compare(p2);
+    }
+
+    template <typename RandomIt, typename Proj>
+    static void sort_recursive(RandomIt arr, int low, int high, int depth, Proj& proj) {
+        if (low >= high) return;
+
+        // 1. Calculate Common Prefix for this partition
+        int common = get_common_prefix(arr, low, high, depth, proj);
+        int new_depth = depth + common;
+
+        // 2. Partition
+        // Random pivot
+        int pivot_idx = low + (rand() % (high - low + 1));
+        std::iter_swap(arr + low, arr + pivot_idx);
+        // The pivot stays at arr[low] until the loop ends, so its key view stays valid
+        const std::string_view pivot = key(arr, low, proj);
+
+        int i = low + 1;
+        int j = high;
+
+        while (true) {
+            while (i <= j && compare_skip(key(arr, i, proj), pivot, new_depth) < 0) i++;
+            while (i <= j && compare_skip(key(arr, j, proj), pivot, new_depth) > 0) j--;
+            
+            if (i <= j) {
+                std::iter_swap(arr + i, arr + j);
+                i++;
+                j--;
+            } else {
+                break;
+            }
+        }
+        
+        std::iter_swap(arr + low, arr + j);
+
+        // 3. Recurse with updated depth
+        sort_recursive(arr, low, j - 1, new_depth, proj);
+        sort_recursive(arr, i, high, new_depth, proj);
+    }
+};
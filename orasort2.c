@@ -3,6 +3,9 @@
 #include <string.h>
 #include <stdint.h>
 #include <limits.h>
+#include <time.h>
+
+#include "orasort2.h"
 
 // --- Platform Specifics for Optimization ---
 
@@ -89,6 +92,13 @@ int compare_and_count(const StringItem *a, const StringItem *b, int depth, int *
         return (a->cache < b->cache) ? -1 : 1;
     }
 
+    // Equal caches holding the terminator: both strings end here and are equal.
+    // Scanning on would read past the end of both.
+    if ((a->cache & 0xFF) == 0) {
+        *match_len_out = (int)strlen(a->ptr + depth);
+        return 0;
+    }
+
     // 2. Slow Path: Caches match (first 8 bytes identical)
     // Scan deeper
     const char *s1 = a->ptr + depth + 8;
@@ -215,9 +225,340 @@ void optimized_orasort(char **strings, int n) {
     free(items);
 }
 
+// --- American Flag Sort ---
+// In-place MSD radix sort for memory-constrained hosts: no N-sized buffer.
+// Each level counts the keys per byte value, then moves every key straight
+// to its bucket by cycle leader: take the key at the next unfilled slot of
+// a bucket, drop it at the next slot of its own bucket and carry on with the
+// key it displaced until one belongs where the cycle started. Buckets of
+// FLAG_SORT_CUTOFF keys or fewer go to the cached quicksort through a stack
+// buffer.
+//
+// Extra space: the 256-entry tables of each level on the call stack. Every
+// bucket but the largest is a recursive call and the largest one is sorted
+// by the loop, so at most log2(n) levels are live at once.
+
+#define FLAG_SORT_CUTOFF 32
+
+static void flag_sort_small(char **strings, int n, int depth) {
+    StringItem items[FLAG_SORT_CUTOFF];
+    for (int i = 0; i < n; i++) {
+        items[i].ptr = strings[i];
+        refresh_cache(&items[i], depth);
+    }
+    orasort_recursive(items, 0, n - 1, depth);
+    for (int i = 0; i < n; i++) strings[i] = items[i].ptr;
+}
+
+static void flag_sort_recursive(char **strings, int n, int depth) {
+    while (n > FLAG_SORT_CUTOFF) {
+        int count[256] = {0};
+        for (int i = 0; i < n; i++) count[(unsigned char)strings[i][depth]]++;
+
+        // All keys share this byte: go one deeper without moving anything.
+        // Keys that all end here are equal.
+        int first = (unsigned char)strings[0][depth];
+        if (count[first] == n) {
+            if (first == 0) return;
+            depth++;
+            continue;
+        }
+
+        int next[256], end[256];
+        int pos = 0;
+        for (int b = 0; b < 256; b++) {
+            next[b] = pos;
+            pos += count[b];
+            end[b] = pos;
+        }
+
+        // Cycle-leader permutation
+        for (int b = 0; b < 256; b++) {
+            while (next[b] < end[b]) {
+                char *v = strings[next[b]];
+                int c = (unsigned char)v[depth];
+                while (c != b) {
+                    char *displaced = strings[next[c]];
+                    strings[next[c]++] = v;
+                    v = displaced;
+                    c = (unsigned char)v[depth];
+                }
+                strings[next[b]++] = v;
+            }
+        }
+
+        // Bucket 0 holds the keys ending here: equal, already in place.
+        int largest = 1;
+        for (int b = 2; b < 256; b++) {
+            if (count[b] > count[largest]) largest = b;
+        }
+        for (int b = 1; b < 256; b++) {
+            if (b != largest && count[b] > 1) flag_sort_recursive(strings + end[b] - count[b], count[b], depth + 1);
+        }
+        strings += end[largest] - count[largest];
+        n = count[largest];
+        depth++;
+    }
+    if (n > 1) flag_sort_small(strings, n, depth);
+}
+
+void american_flag_sort(char **strings, int n) {
+    if (n <= 1) return;
+    flag_sort_recursive(strings, n, 0);
+}
+
+// --- Record Sort ---
+// Binary keys carry their length instead of a terminator: a NUL is an
+// ordinary key byte. The cache pads bytes past the end of a key with zeros,
+// so when two caches are equal the lengths decide whether the keys are.
+
+typedef struct {
+    const unsigned char *key;  // Key of the record
+    size_t len;                // Key length in bytes
+    size_t index;              // Position of the record in the input
+    uint64_t cache;            // Bytes [depth, depth + 8) of the key (Big Endian, zero padded)
+} RecordItem;
+
+static void refresh_record_cache(RecordItem *item, size_t depth) {
+    uint8_t buf[8] = {0};
+    uint64_t raw;
+    if (depth < item->len) {
+        size_t remaining = item->len - depth;
+        memcpy(buf, item->key + depth, remaining < 8 ? remaining : 8);
+    }
+    memcpy(&raw, buf, 8);
+    item->cache = bswap64(raw);
+}
+
+// compare_and_count for keys with lengths. The match length never exceeds
+// the shorter remaining key, so the depth never passes the end of a key.
+static int compare_records(const RecordItem *a, const RecordItem *b, size_t depth, size_t *match_len_out) {
+    size_t rem_a = a->len > depth ? a->len - depth : 0;
+    size_t rem_b = b->len > depth ? b->len - depth : 0;
+    size_t shorter = rem_a < rem_b ? rem_a : rem_b;
+
+    // 1. Fast Path: padding sorts below every byte, so a proper prefix
+    // compares lower here too
+    if (a->cache != b->cache) {
+        size_t match = (size_t)clz64(a->cache ^ b->cache) / 8;
+        *match_len_out = match < shorter ? match : shorter;
+        return (a->cache < b->cache) ? -1 : 1;
+    }
+
+    // 2. Slow Path: scan past the cache while both keys go on
+    size_t k = shorter < 8 ? shorter : 8;
+    while (k < shorter && a->key[depth + k] == b->key[depth + k]) k++;
+    *match_len_out = k;
+    if (k < shorter) return (a->key[depth + k] < b->key[depth + k]) ? -1 : 1;
+    return (rem_a > rem_b) - (rem_a < rem_b);
+}
+
+static void swap_records(RecordItem *a, RecordItem *b) {
+    RecordItem temp = *a;
+    *a = *b;
+    *b = temp;
+}
+
+// orasort_recursive over record items.
+static void records_recursive(RecordItem *arr, ptrdiff_t low, ptrdiff_t high, size_t depth) {
+    if (low >= high) return;
+
+    ptrdiff_t mid = low + (high - low) / 2;
+    swap_records(&arr[low], &arr[mid]);
+    RecordItem pivot = arr[low];
+
+    size_t min_common_with_pivot = SIZE_MAX;
+    ptrdiff_t i = low + 1;
+    ptrdiff_t j = high;
+
+    while (1) {
+        while (i <= j) {
+            size_t match_len = 0;
+            int cmp = compare_records(&arr[i], &pivot, depth, &match_len);
+            if (match_len < min_common_with_pivot) min_common_with_pivot = match_len;
+            if (cmp >= 0) break;
+            i++;
+        }
+        while (i <= j) {
+            size_t match_len = 0;
+            int cmp = compare_records(&arr[j], &pivot, depth, &match_len);
+            if (match_len < min_common_with_pivot) min_common_with_pivot = match_len;
+            if (cmp <= 0) break;
+            j--;
+        }
+        if (i <= j) {
+            swap_records(&arr[i], &arr[j]);
+            i++;
+            j--;
+        } else {
+            break;
+        }
+    }
+
+    swap_records(&arr[low], &arr[j]);
+    if (min_common_with_pivot == SIZE_MAX) min_common_with_pivot = 0;
+    size_t new_depth = depth + min_common_with_pivot;
+
+    if (low < j - 1) {
+        if (new_depth > depth) {
+            for (ptrdiff_t k = low; k <= j - 1; k++) refresh_record_cache(&arr[k], new_depth);
+        }
+        records_recursive(arr, low, j - 1, new_depth);
+    }
+    if (j + 1 < high) {
+        if (new_depth > depth) {
+            for (ptrdiff_t k = j + 1; k <= high; k++) refresh_record_cache(&arr[k], new_depth);
+        }
+        records_recursive(arr, j + 1, high, new_depth);
+    }
+}
+
+// Moves the records into the order of the sorted items, cycle by cycle
+// through one temporary record, so each record is copied about once.
+static void permute_records(unsigned char *records, size_t nmemb, size_t size, RecordItem *items,
+                            unsigned char *tmp) {
+    for (size_t start = 0; start < nmemb; start++) {
+        if (items[start].index == start) continue;
+        memcpy(tmp, records + start * size, size);
+        size_t k = start;
+        while (items[k].index != start) {
+            size_t from = items[k].index;
+            memcpy(records + k * size, records + from * size, size);
+            items[k].index = k;
+            k = from;
+        }
+        memcpy(records + k * size, tmp, size);
+        items[k].index = k;
+    }
+}
+
+int orasort_records_r(void *base, size_t nmemb, size_t size, orasort_key_fn key, void *arg) {
+    if (nmemb <= 1) return 0;
+
+    RecordItem *items = (RecordItem *)malloc(nmemb * sizeof(RecordItem));
+    unsigned char *tmp = (unsigned char *)malloc(size);
+    if (!items || !tmp) {
+        free(items);
+        free(tmp);
+        return -1;
+    }
+
+    unsigned char *records = (unsigned char *)base;
+    for (size_t i = 0; i < nmemb; i++) {
+        items[i].key = (const unsigned char *)key(records + i * size, &items[i].len, arg);
+        items[i].index = i;
+        refresh_record_cache(&items[i], 0);
+    }
+
+    records_recursive(items, 0, (ptrdiff_t)nmemb - 1, 0);
+    permute_records(records, nmemb, size, items, tmp);
+
+    free(tmp);
+    free(items);
+    return 0;
+}
+
+typedef struct {
+    size_t offset;
+    size_t len;
+} KeyField;
+
+static const void *field_key(const void *record, size_t *len, void *arg) {
+    const KeyField *field = (const KeyField *)arg;
+    *len = field->len;
+    return (const unsigned char *)record + field->offset;
+}
+
+int orasort_records(void *base, size_t nmemb, size_t size, size_t key_offset, size_t key_len) {
+    KeyField field = {key_offset, key_len};
+    return orasort_records_r(base, nmemb, size, field_key, &field);
+}
+
 // --- Example Usage ---
+// Build with -DORASORT_LIBRARY to leave it out and link the sort into other programs.
+
+#ifndef ORASORT_LIBRARY
+// Appends a copy of line[0..len) to keys, growing it as needed. Returns 0,
+// or -1 if memory runs out.
+static int push_key(char ***keys, int *n, int *cap, const char *line, size_t len) {
+    if (*n == *cap) {
+        char **grown = realloc(*keys, (size_t)*cap * 2 * sizeof(char *));
+        if (!grown) return -1;
+        *keys = grown;
+        *cap *= 2;
+    }
+    char *key = malloc(len + 1);
+    if (!key) return -1;
+    memcpy(key, line, len);
+    key[len] = '\0';
+    (*keys)[(*n)++] = key;
+    return 0;
+}
+
+// Reads one key per line (as written by orasort_gen). Returns NULL on failure.
+static char **load_keys(const char *path, int *count) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    int n = 0, cap = 1024;
+    char **keys = malloc((size_t)cap * sizeof(char *));
+    size_t len = 0, size = 256;
+    char *line = malloc(size);
+    int ok = keys && line;
+    int c;
+    while (ok && (c = fgetc(f)) != EOF) {
+        if (c != '\n') {
+            if (len == size) {
+                char *grown = realloc(line, size * 2);
+                if (!grown) {
+                    ok = 0;
+                    break;
+                }
+                line = grown;
+                size *= 2;
+            }
+            line[len++] = (char)c;
+            continue;
+        }
+        if (len > 0 && line[len - 1] == '\r') len--;
+        ok = push_key(&keys, &n, &cap, line, len) == 0;
+        len = 0;
+    }
+    if (ok && len > 0) ok = push_key(&keys, &n, &cap, line, len) == 0;
+    free(line);
+    fclose(f);
+    if (!ok) {
+        for (int i = 0; i < n; i++) free(keys[i]);
+        free(keys);
+        return NULL;
+    }
+    *count = n;
+    return keys;
+}
+
+// With a file argument, sorts its keys and checks the result.
+static int sort_file(const char *path) {
+    int n;
+    char **keys = load_keys(path, &n);
+    if (!keys) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return 1;
+    }
+    clock_t start = clock();
+    optimized_orasort(keys, n);
+    double ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+    int sorted = 1;
+    for (int i = 1; i < n && sorted; i++) sorted = strcmp(keys[i - 1], keys[i]) <= 0;
+    printf("%s: %d keys in %.2f ms, %s\n", path, n, ms, sorted ? "sorted" : "NOT sorted");
+
+    for (int i = 0; i < n; i++) free(keys[i]);
+    free(keys);
+    return sorted ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) return sort_file(argv[1]);
 
-int main() {
     char *data[] = {
         "http://www.google.com/search",
         "http://www.google.com/mail",
@@ -238,5 +579,17 @@ int main() {
     printf("\nSorted:\n");
     for (int i = 0; i < n; i++) printf("  %s\n", data[i]);
 
+    // Records keyed by a big-endian id: binary keys, NUL bytes included
+    typedef struct {
+        unsigned char id[4];
+        char name[12];
+    } Row;
+    Row rows[] = {{{0, 0, 1, 0}, "third"}, {{0, 0, 0, 7}, "second"}, {{0, 0, 0, 0}, "first"}};
+    orasort_records(rows, 3, sizeof(Row), offsetof(Row, id), sizeof(rows[0].id));
+
+    printf("\nRecords by id:\n");
+    for (int i = 0; i < 3; i++) printf("  %s\n", rows[i].name);
+
     return 0;
 }
+#endif
@@ -2,226 +2,175 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
-#include <cstdint>
-#include <climits>
-
-// --- Helper for Endianness ---
-// We need Big Endian loading so integer comparison matches lexicographical order.
-// e.g. "ABCD" (0x41424344) < "ABCE" (0x41424345) works naturally.
-inline uint64_t load_bytes_be(const char* ptr) {
-    uint64_t cache = 0;
-    // Safe copy of up to 8 bytes
-    std::memcpy(&cache, ptr, strnlen(ptr, 8)); 
-    
-    // Determine system endianness or use builtin
-    // __builtin_bswap64 is GCC/Clang specific. 
-    // If on Little Endian (x86), we swap. 
-    // (In a prod env, use std::endian check)
-    #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
-        return __builtin_bswap64(cache);
-    #else
-        return cache;
-    #endif
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <mutex>
+#include <thread>
+
+#include "orasort2.hpp"
+#include "orasort_datasets.hpp"
+#include "orasort_shuffle.hpp"
+#include "orasort_symbols.hpp"
+
+// With a file argument (one key per line, see orasort_gen), sorts its keys
+// and checks the result.
+int sort_file(const char* path) {
+    std::vector<std::string> keys;
+    if (!DatasetGenerator::read_keys(path, keys)) {
+        std::cerr << "cannot read " << path << "\n";
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    OptimizedOrasort::sort_parallel(keys);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    bool sorted = std::is_sorted(keys.begin(), keys.end());
+    std::cout << path << ": " << keys.size() << " keys in " << ms << " ms, " << (sorted ? "sorted" : "NOT sorted")
+              << "\n";
+    return sorted ? 0 : 1;
 }
 
-// --- Data Structure with Caching ---
-struct StringItem {
-    const char* ptr;    // Original string pointer
-    uint64_t cache;     // Cached next 8 bytes
-
-    // Refresh the cache based on current depth
-    void refresh_cache(int depth) {
-        // We load 8 bytes starting from ptr + depth
-        // Note: We need to handle null terminators safely. 
-        // load_bytes_be handles reading up to null.
-        // If string ends before depth, it loads 0s.
-        size_t len = strlen(ptr);
-        if (static_cast<size_t>(depth) >= len) {
-            cache = 0;
-        } else {
-            // We use a safe loader. 
-            // For raw speed in C++, usually we ensure strings are padded 
-            // or use specific logic, but here allows safe strncpy-like behavior.
-            uint64_t val = 0;
-            const char* start = ptr + depth;
-            size_t remaining = len - depth;
-            size_t copy_len = (remaining < 8) ? remaining : 8;
-            
-            // Temporary buffer to ensure zero-padding for correct int comparison
-            uint8_t buf[8] = {0};
-            std::memcpy(buf, start, copy_len);
-            
-            // Load into uint64 and swap
-            uint64_t raw;
-            std::memcpy(&raw, buf, 8);
-            
-            #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
-                cache = __builtin_bswap64(raw);
-            #else
-                cache = raw;
-            #endif
+// Shuffles generated keys through a small memory budget, so that the
+// writer spills many runs, then reads every partition back and checks its
+// records, their order and seek().
+bool check_shuffle() {
+    const uint32_t partitions = 4;
+    const std::vector<std::string> keys = DatasetGenerator::generate("words", 100000);
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "orasort-shuffle-demo";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    ShuffleOptions options;
+    options.directory = dir.string();
+    options.partitions = partitions;
+    options.memory_budget = 256 << 10;
+    ShuffleWriter writer(options);
+    auto partition_of = [&](size_t i) { return static_cast<uint32_t>(std::hash<std::string>()(keys[i]) % partitions); };
+    bool ok = true;
+    {
+        std::vector<std::thread> producers;
+        std::mutex failed;
+        for (size_t t = 0; t < 4; ++t) {
+            producers.emplace_back([&, t] {
+                for (size_t i = t; i < keys.size(); i += 4) {
+                    if (!writer.add(partition_of(i), keys[i], std::to_string(i))) {
+                        std::lock_guard<std::mutex> lock(failed);
+                        ok = false;
+                    }
+                }
+            });
         }
+        for (auto& p : producers) p.join();
     }
-};
-
-class OptimizedOrasort {
-public:
-    static void sort(std::vector<std::string>& data) {
-        if (data.empty()) return;
-
-        // 1. Convert to Items and cache first 8 bytes (Depth 0)
-        std::vector<StringItem> items(data.size());
-        for (size_t i = 0; i < data.size(); ++i) {
-            items[i].ptr = data[i].c_str();
-            items[i].refresh_cache(0);
+    ok = ok && writer.finish();
+
+    for (uint32_t p = 0; ok && p < partitions; ++p) {
+        std::vector<std::pair<std::string, std::string>> expected, found;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (partition_of(i) == p) expected.emplace_back(keys[i], std::to_string(i));
         }
+        std::sort(expected.begin(), expected.end());
 
-        sort_recursive(items, 0, items.size() - 1, 0);
+        ShuffleReader reader(writer.partition_path(p));
+        std::string key, value;
+        while (reader.next(key, value)) found.emplace_back(key, value);
+        ok = reader.ok() && reader.records() == expected.size() && found.size() == expected.size() &&
+             std::is_sorted(found.begin(), found.end(),
+                            [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::sort(found.begin(), found.end());
+        ok = ok && found == expected;
 
-        // 2. Write back sorted order (optional, depending on use case)
-        // Here we just reorder the original vector to match
-        std::vector<std::string> sorted_data;
-        sorted_data.reserve(data.size());
-        for (const auto& item : items) {
-            sorted_data.emplace_back(item.ptr);
+        // seek() lands on the first key not below the probe, present or not
+        for (size_t k = 0; ok && k < expected.size(); k += expected.size() / 50 + 1) {
+            const std::string probe = expected[k].first + (k % 2 ? "" : "~");
+            auto want = std::lower_bound(expected.begin(), expected.end(), probe,
+                                         [](const auto& e, const std::string& key) { return e.first < key; });
+            reader.seek(probe);
+            const bool more = reader.next(key, value);
+            ok = want == expected.end() ? !more : more && key == want->first;
         }
-        data = std::move(sorted_data);
     }
 
-private:
-    // Returns: <0 if s1 < s2, >0 if s1 > s2, 0 if equal
-    // Updates: common_count with the number of matching bytes found BEYOND the cache
-    static int compare_and_count(const StringItem& a, const StringItem& b, int depth, int& match_len_out) {
-        // 1. Fast Path: Compare Caches
-        if (a.cache < b.cache) {
-            // They differ in the first 8 bytes.
-            // We need to find exactly WHERE they differ to update common prefix length?
-            // Actually, if we are strictly sorting, we don't need exact count for the sort,
-            // but we need it for the "Common Prefix Skipping" optimization.
-            
-            // Count matching leading zeros (clz) in XOR to find matching bits
-            uint64_t diff = a.cache ^ b.cache;
-            // distinct bits. __builtin_clzll returns number of leading zeros.
-            // divide by 8 to get bytes.
-            int matching_bytes = __builtin_clzll(diff) / 8;
-            match_len_out = matching_bytes;
-            return -1;
-        } 
-        if (a.cache > b.cache) {
-            uint64_t diff = a.cache ^ b.cache;
-            int matching_bytes = __builtin_clzll(diff) / 8;
-            match_len_out = matching_bytes;
-            return 1;
-        }
+    std::cout << "\nShuffle of " << keys.size() << " records into " << partitions << " partitions, "
+              << writer.spills() << " spills: " << (ok ? "complete and ordered" : "FAILED") << "\n";
+    std::filesystem::remove_all(dir);
+    return ok;
+}
+
+// Splits generated keys into the ranges of sorted splitters, an empty and a
+// repeated one among them, on several threads, and checks that range r
+// holds exactly the keys in (splitters[r - 1], splitters[r]], in input order.
+bool check_partition_ranges() {
+    struct Row {
+        std::string key;
+        size_t index;
+    };
+    const std::vector<std::string> keys = DatasetGenerator::generate("urls", 200000);
+    std::vector<Row> rows(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) rows[i] = Row{keys[i], i};
 
-        // 2. Slow Path: Caches are equal (8 bytes match).
-        // Scan remaining characters.
-        const char* s1 = a.ptr + depth + 8;
-        const char* s2 = b.ptr + depth + 8;
-        int k = 0;
-        while (s1[k] && s2[k] && s1[k] == s2[k]) {
-            k++;
+    std::vector<std::string> splitters = {""};
+    for (size_t i = 0; i < keys.size(); i += keys.size() / 15) splitters.push_back(keys[i]);
+    splitters.push_back(splitters.back());
+    std::sort(splitters.begin(), splitters.end());
+
+    const std::vector<size_t> offsets = OptimizedOrasort::partition_ranges(rows, splitters, &Row::key, 4);
+    bool ok = offsets.size() == splitters.size() + 2 && offsets.front() == 0 && offsets.back() == rows.size();
+    std::vector<bool> seen(rows.size(), false);
+    for (size_t r = 0; ok && r + 1 < offsets.size(); ++r) {
+        for (size_t k = offsets[r]; ok && k < offsets[r + 1]; ++k) {
+            const Row& row = rows[k];
+            ok = (r == 0 || row.key > splitters[r - 1]) && (r == splitters.size() || row.key <= splitters[r]) &&
+                 (k == offsets[r] || rows[k - 1].index < row.index) && !seen[row.index] &&
+                 row.key == keys[row.index];
+            seen[row.index] = true;
         }
-        
-        match_len_out = 8 + k; // 8 from cache + k from scan
-        return (unsigned char)s1[k] - (unsigned char)s2[k];
     }
+    std::cout << "\nRange partition of " << rows.size() << " keys by " << splitters.size() << " splitters: "
+              << (ok ? "exact and stable" : "FAILED") << "\n";
+    return ok;
+}
 
-    static void sort_recursive(std::vector<StringItem>& arr, int low, int high, int depth) {
-        if (low >= high) return;
-
-        // Optimization: If the array is small, standard insertion sort is faster, 
-        // but we stick to the requested algorithm logic.
-
-        // Pivot Selection (Median of 3 recommended, using random for brevity)
-        int pivot_idx = low + (rand() % (high - low + 1));
-        std::swap(arr[low], arr[pivot_idx]);
-        StringItem pivot = arr[low]; 
-
-        // Track the minimum common prefix length shared between the PIVOT and ALL elements in this partition.
-        // Initialize to infinity (or max possible).
-        int min_common_with_pivot = INT_MAX;
-
-        int i = low + 1;
-        int j = high;
-
-        // --- Partitioning with Integrated Prefix Scan ---
-        // We use a standard Hoare-like partition but perform prefix counting simultaneously.
-        
-        while (true) {
-            // Scan i right
-            while (i <= j) {
-                int match_len = 0;
-                int cmp = compare_and_count(arr[i], pivot, depth, match_len);
-                
-                // Update global minimum common prefix
-                if (match_len < min_common_with_pivot) min_common_with_pivot = match_len;
-
-                if (cmp >= 0) break; // Found element >= pivot, stop
-                i++;
-            }
-
-            // Scan j left
-            while (i <= j) {
-                int match_len = 0;
-                // Note: compare_and_count(arr[j], pivot...) implies comparing arr[j] vs pivot
-                // if arr[j] < pivot (result < 0), we stop.
-                // We must be careful with argument order for subtraction logic or use symmetric logic.
-                // Here we used: compare(a, b) -> a - b. 
-                int cmp = compare_and_count(arr[j], pivot, depth, match_len);
-
-                if (match_len < min_common_with_pivot) min_common_with_pivot = match_len;
-
-                if (cmp <= 0) break; // Found element <= pivot, stop
-                j--;
-            }
-
-            if (i <= j) {
-                std::swap(arr[i], arr[j]);
-                i++;
-                j--;
-            } else {
-                break;
-            }
-        }
-        
-        // Restore pivot
-        std::swap(arr[low], arr[j]);
-        
-        // At this point:
-        // arr[low..j-1] are <= pivot
-        // arr[j] is pivot
-        // arr[j+1..high] are >= pivot
-        
-        // min_common_with_pivot now holds the number of bytes that *every* string in this range
-        // shares with the pivot. Consequently, they all share that many bytes with each other.
-        // We can safely increment the depth by this amount for the next recursion.
-        
-        int new_depth = depth + min_common_with_pivot;
-
-        // Recurse Left
-        if (low < j - 1) {
-            // Lazy Update: Before recursing, if we advanced depth, we might need to refresh cache?
-            // Yes. The cache for 'depth' is valid, but for 'new_depth' it is not.
-            // We must update the cache for the sub-range. This is the cost of caching.
-            if (new_depth > depth) {
-                for (int k = low; k <= j - 1; k++) arr[k].refresh_cache(new_depth);
-            }
-            sort_recursive(arr, low, j - 1, new_depth);
+// Sorts random wide-symbol keys, zero symbols and shared prefixes included,
+// with the engine for their symbol type and checks them against
+// std::is_sorted.
+template <typename Sort, typename Key>
+bool check_symbol_sort(const char* name, uint64_t top) {
+    std::mt19937_64 rng(42);
+    std::vector<Key> keys(100000);
+    for (auto& key : keys) {
+        const size_t length = rng() % 24;
+        for (size_t k = 0; k < length; ++k) {
+            // Few distinct symbols near zero and the top: long shared prefixes and embedded zeros
+            const uint64_t symbol = rng() % 4;
+            key.push_back(static_cast<typename Key::value_type>(symbol < 2 ? symbol : top - (symbol - 2)));
         }
+    }
+    Sort::sort(keys);
+    const bool sorted = std::is_sorted(keys.begin(), keys.end());
+    std::cout << "  " << name << ": " << (sorted ? "sorted" : "NOT sorted") << "\n";
+    return sorted;
+}
 
-        // Recurse Right
-        if (j + 1 < high) {
-            if (new_depth > depth) {
-                for (int k = j + 1; k <= high; k++) arr[k].refresh_cache(new_depth);
-            }
-            sort_recursive(arr, j + 1, high, new_depth);
-        }
+int main(int argc, char** argv) {
+    // ORASORT_TRACE=trace.json records a Chrome trace of the run.
+    const char* trace_path = std::getenv("ORASORT_TRACE");
+    if (trace_path) TraceRecorder::instance().enable();
+
+    if (argc > 1) {
+        int status = sort_file(argv[1]);
+#ifdef ORASORT_PROFILE
+        PhaseProfiler::instance().report(std::cout);
+#endif
+        if (trace_path) TraceRecorder::instance().dump(trace_path);
+        return status;
     }
-};
 
-int main() {
+    int status = 0;
+
     // Test Data
     std::vector<std::string> data = {
         "http://www.google.com/search",
@@ -237,10 +186,98 @@ int main() {
     std::cout << "Original:\n";
     for(const auto& s : data) std::cout << "  " << s << "\n";
 
+    std::vector<std::string> compressed = data;
+
     OptimizedOrasort::sort(data);
 
     std::cout << "\nSorted:\n";
     for(const auto& s : data) std::cout << "  " << s << "\n";
 
-    return 0;
+    // Same keys through the order-preserving codec
+    KeyCodec codec = KeyCodec::train_on(compressed);
+    OptimizedOrasort::sort(compressed, codec);
+
+    std::cout << "\nSorted (compressed keys, " << codec.dictionary_size() << " intervals):\n";
+    for(const auto& s : compressed) std::cout << "  " << s << "\n";
+
+    // CHAR(n) columns: trailing spaces are insignificant under PAD SPACE
+    std::vector<std::string> column = {"pear  ", "apple", "pear", "apple\t", "apple "};
+    OptimizedOrasort::sort(column, KeyIdentity{}, KeyPadding::Space);
+
+    std::cout << "\nSorted (PAD SPACE):\n";
+    for(const auto& s : column) std::cout << "  [" << s << "]\n";
+
+    // (user, time) order without concatenated keys
+    struct Event { std::string user, time; };
+    std::vector<Event> events = {
+        {"carol", "09:30"}, {"alice", "12:00"}, {"bob", "08:15"}, {"alice", "07:45"}, {"carol", "09:05"}};
+    OptimizedOrasort::sort_composite(events, &Event::user, &Event::time);
+
+    std::cout << "\nSorted by user, then time:\n";
+    for(const auto& e : events) std::cout << "  " << e.user << " " << e.time << "\n";
+
+    // Parallel sort of a larger generated set
+    std::vector<std::string> many = DatasetGenerator::generate("urls", 200000);
+    OptimizedOrasort::sort_parallel(many, 4);
+    std::cout << "\nParallel sort of " << many.size() << " keys: "
+              << (std::is_sorted(many.begin(), many.end()) ? "sorted" : "NOT sorted") << "\n";
+
+    // Keys sharing one address (pointers to the same literal) map back to
+    // their elements in constant time each
+    std::vector<const char*> shared(80000, "same");
+    for (size_t i = 0; i < shared.size(); i += 7) shared[i] = "other";
+    auto shared_start = std::chrono::steady_clock::now();
+    OptimizedOrasort::sort(shared);
+    double shared_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shared_start).count();
+    bool shared_sorted = std::is_sorted(shared.begin(), shared.end(),
+                                        [](const char* a, const char* b) { return std::strcmp(a, b) < 0; });
+    std::cout << "\nSort of " << shared.size() << " pointers to two literals: " << shared_ms << " ms, "
+              << (shared_sorted ? "sorted" : "NOT sorted") << "\n";
+    if (!shared_sorted) status = 1;
+
+    // Repeated traced parallel sorts reuse the buffers of exited workers
+    if (!trace_path) {
+        TraceRecorder& recorder = TraceRecorder::instance();
+        recorder.enable();
+        std::vector<std::string> traced = DatasetGenerator::generate("words", 100000);
+        for (int round = 0; round < 20; ++round) {
+            std::vector<std::string> copy = traced;
+            OptimizedOrasort::sort_parallel(copy, 4);
+        }
+        const size_t buffers = recorder.buffer_count();
+        recorder.enable(false);
+        recorder.clear();
+        const bool bounded = buffers <= 4 + 1;
+        std::cout << "\n20 traced parallel sorts: " << buffers << " trace buffers, "
+                  << (bounded ? "bounded" : "NOT bounded") << "\n";
+        if (!bounded) status = 1;
+    }
+
+    if (!check_partition_ranges()) status = 1;
+    if (!check_shuffle()) status = 1;
+
+    // UTF-16, UTF-32 and token-ID keys sorted without converting to bytes
+    std::cout << "\nWide symbol keys:\n";
+    if (!check_symbol_sort<Utf16Orasort, std::u16string>("UTF-16", 0xFFFF)) status = 1;
+    if (!check_symbol_sort<Utf32Orasort, std::u32string>("UTF-32", 0x10FFFF)) status = 1;
+    if (!check_symbol_sort<TokenOrasort, std::vector<uint32_t>>("token IDs", 0xFFFFFFFF)) status = 1;
+
+    // Percentiles without a full sort
+    std::vector<std::string> sample = DatasetGenerator::generate("words", 200000);
+    const std::vector<size_t> ranks = OptimizedOrasort::quantile_ranks(sample.size(), {0.5, 0.9, 0.99});
+    OptimizedOrasort::select(sample, ranks);
+    std::cout << "\nPercentiles of " << sample.size() << " words: p50 " << sample[ranks[0]] << ", p90 "
+              << sample[ranks[1]] << ", p99 " << sample[ranks[2]] << "\n";
+
+#ifdef ORASORT_PROFILE
+    std::cout << "\nProfile:\n";
+    PhaseProfiler::instance().report(std::cout);
+#endif
+
+    if (trace_path && TraceRecorder::instance().dump(trace_path)) {
+        std::cout << "\nTrace written to " << trace_path << "\n";
+    }
+
+    return status;
 }
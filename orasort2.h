@@ -0,0 +1,41 @@
+#ifndef ORASORT2_H
+#define ORASORT2_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sorts n NUL-terminated strings in place.
+void optimized_orasort(char **strings, int n);
+
+// Same order, in place: an MSD radix sort (American flag sort) that needs no
+// N-sized buffer, only O(256 log n) words of stack.
+void american_flag_sort(char **strings, int n);
+
+// --- Record Sort ---
+//
+// Sorts nmemb records of size bytes each, qsort style, by a binary key: the
+// keys may hold any bytes, NULs included, and compare as unsigned bytes with
+// a proper prefix ordered first. Records are moved into place once, at the
+// end; the sort itself runs on (cache, key, index) items.
+//
+// Both return 0, or -1 if the working memory cannot be allocated (the
+// records are then left untouched).
+
+// Keys of key_len bytes at key_offset in every record.
+int orasort_records(void *base, size_t nmemb, size_t size, size_t key_offset, size_t key_len);
+
+// Keys located by a callback: it returns the key of record and stores its
+// length in *len. The key must stay valid and unchanged until the sort
+// returns; it may point into the record.
+typedef const void *(*orasort_key_fn)(const void *record, size_t *len, void *arg);
+
+int orasort_records_r(void *base, size_t nmemb, size_t size, orasort_key_fn key, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
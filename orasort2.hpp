@@ -0,0 +1,1883 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <climits>
+#include <cmath>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <cstdlib>
+
+#include "orasort_codec.hpp"
+#include "orasort_key.hpp"
+#include "orasort_profile.hpp"
+#include "orasort_trace.hpp"
+#include "orasort_tuning.hpp"
+
+// x86-64 SIMD partition kernels are compiled with per-function target
+// attributes and picked at runtime, so the binary still runs on any x86-64.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #define ORASORT_X86_SIMD 1
+    #include <immintrin.h>
+#else
+    #define ORASORT_X86_SIMD 0
+#endif
+
+// --- Helper for Endianness ---
+// We need Big Endian loading so integer comparison matches lexicographical order.
+// e.g. "ABCD" (0x41424344) < "ABCE" (0x41424345) works naturally.
+inline uint64_t load_bytes_be(const char* ptr) {
+    uint64_t cache = 0;
+    // Safe copy of up to 8 bytes
+    size_t len = strnlen(ptr, 8);
+    ORASORT_INSPECT(len);
+    std::memcpy(&cache, ptr, len);
+    
+    // Determine system endianness or use builtin
+    // __builtin_bswap64 is GCC/Clang specific. 
+    // If on Little Endian (x86), we swap. 
+    // (In a prod env, use std::endian check)
+    #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        return __builtin_bswap64(cache);
+    #else
+        return cache;
+    #endif
+}
+
+struct KeyAlphabet;
+
+// What follows the end of a key. Zero padding is plain byte order. Space
+// padding is SQL PAD SPACE (CHAR(n)) order: keys compare as if padded with
+// spaces to the same length, so trailing spaces are insignificant and
+// "ab" == "ab  " while "ab\t" < "ab". Keys equal under PAD SPACE come out
+// adjacent in no particular order.
+enum class KeyPadding { Zero, Space };
+
+// --- Data Structure with Caching ---
+struct StringItem {
+    const char* ptr;    // Original string pointer
+    uint64_t cache;     // Cached next symbols (8 bytes, or more reduced symbols)
+
+    // Refresh the cache based on current depth.
+    // Depth never runs past the end of the string: match lengths only count
+    // symbols that are really shared, so ptr + depth is always readable.
+    // If the string ends inside the window the cache is zero padded.
+    void refresh_cache(int depth, const KeyAlphabet& alpha);
+};
+
+// --- Alphabet Reduction ---
+// Keys drawn from a small alphabet (digits, hex, DNA, base64) waste most of
+// every cached byte. We remap the bytes that actually occur to a dense code
+// that preserves their order (code 0 stays reserved for "end of string") and
+// pack the narrower symbols into the 64-bit cache: 16 decimal digits, 12 hex
+// digits or 21 DNA bases per word instead of 8 bytes.
+struct KeyAlphabet {
+    uint8_t code[256];  // byte -> dense code, monotone in the byte value
+    int bits;           // bits per symbol in the cache word
+    int symbols;        // symbols held by one cache word
+    uint64_t pad_word;  // pad symbol in every slot: 0, or the space code under KeyPadding::Space
+
+    // Plain bytes: 8 symbols of 8 bits, no remapping.
+    static KeyAlphabet identity(KeyPadding padding = KeyPadding::Zero) {
+        KeyAlphabet alpha;
+        for (int c = 0; c < 256; ++c) alpha.code[c] = static_cast<uint8_t>(c);
+        alpha.bits = 8;
+        alpha.symbols = 8;
+        alpha.set_padding(padding);
+        return alpha;
+    }
+
+    // Input analysis: collect the used byte set and size the code to it.
+    // Gives up (identity) as soon as the alphabet needs the full 8 bits.
+    // Space padding needs a code for the space whether keys hold one or not.
+    static KeyAlphabet analyze(const std::vector<StringItem>& items, KeyPadding padding = KeyPadding::Zero) {
+        bool used[256] = {false};
+        int distinct = 0;
+        if (padding == KeyPadding::Space) {
+            used[' '] = true;
+            distinct = 1;
+        }
+        for (const auto& item : items) {
+            const unsigned char* start = reinterpret_cast<const unsigned char*>(item.ptr);
+            const unsigned char* p = start;
+            for (; *p; ++p) {
+                if (used[*p]) continue;
+                used[*p] = true;
+                if (++distinct > 127) {
+                    ORASORT_INSPECT(p - start + 1);
+                    return identity(padding);
+                }
+            }
+            ORASORT_INSPECT(p - start);
+        }
+
+        KeyAlphabet alpha;
+        int next = 0;
+        for (int c = 0; c < 256; ++c) {
+            alpha.code[c] = used[c] ? static_cast<uint8_t>(++next) : 0;
+        }
+        alpha.bits = 1;
+        while ((1 << alpha.bits) <= distinct) alpha.bits++;
+        alpha.symbols = 64 / alpha.bits;
+        alpha.set_padding(padding);
+        return alpha;
+    }
+
+    bool pads_spaces() const { return pad_word != 0; }
+
+    // Packs the symbols starting at ptr into a cache word, first symbol in the
+    // most significant bits, padded after the end of the string.
+    uint64_t load(const char* ptr) const {
+        if (bits == 8 && !pad_word) return load_bytes_be(ptr);
+
+        uint64_t word = 0;
+        int shift = 64;
+        int k = 0;
+        for (; k < symbols && ptr[k]; ++k) {
+            shift -= bits;
+            word |= static_cast<uint64_t>(code[static_cast<unsigned char>(ptr[k])]) << shift;
+        }
+        ORASORT_INSPECT(k);
+        if (shift) word |= pad_word & ((shift == 64) ? ~0ULL : (1ULL << shift) - 1);
+        return word;
+    }
+
+    // True when the last symbol slot of the word is the end-of-string code.
+    // Zero padding only: under space padding the end of a key looks like spaces.
+    bool ends_in(uint64_t word) const {
+        int tail_shift = 64 - bits * symbols;
+        return ((word >> tail_shift) & ((1ULL << bits) - 1)) == 0;
+    }
+
+    // Of the first m symbols of a word, the ones before their trailing run of
+    // pad symbols. Under space padding a pad and a real space look the same,
+    // so only these are sure to lie inside the key; match lengths are cut
+    // back to them so that depth never passes the end of a key.
+    int unpadded(uint64_t word, int m) const {
+        if (!pad_word || m == 0) return m;
+        const uint64_t head = (word ^ pad_word) >> (64 - m * bits);
+        return head ? m - __builtin_ctzll(head) / bits : 0;
+    }
+
+private:
+    void set_padding(KeyPadding padding) {
+        pad_word = 0;
+        if (padding != KeyPadding::Space) return;
+        for (int k = 0; k < symbols; ++k) pad_word |= static_cast<uint64_t>(code[' ']) << (64 - bits * (k + 1));
+    }
+};
+
+inline void StringItem::refresh_cache(int depth, const KeyAlphabet& alpha) {
+    cache = alpha.load(ptr + depth);
+}
+
+// --- Partition Kernel Dispatch ---
+enum class PartitionKernel { Scalar, AVX2, AVX512 };
+
+inline PartitionKernel detect_partition_kernel() {
+#if ORASORT_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return PartitionKernel::AVX512;
+    if (__builtin_cpu_supports("avx2")) return PartitionKernel::AVX2;
+#endif
+    return PartitionKernel::Scalar;
+}
+
+// Kernel named by a tuning profile, unless the CPU lacks it.
+inline PartitionKernel select_partition_kernel(const std::string& name) {
+    const PartitionKernel best = detect_partition_kernel();
+    PartitionKernel wanted = best;
+    if (name == "scalar") wanted = PartitionKernel::Scalar;
+    else if (name == "avx2") wanted = PartitionKernel::AVX2;
+    else if (name == "avx512") wanted = PartitionKernel::AVX512;
+    return static_cast<int>(wanted) <= static_cast<int>(best) ? wanted : best;
+}
+
+template <typename Symbol>
+class SymbolOrasort;
+
+class OptimizedOrasort {
+    template <typename Symbol>
+    friend class SymbolOrasort;  // partitions its items with hoare_partition_items()
+
+public:
+    // Work done by one sort, for traffic and bandwidth estimates.
+    struct SortStats {
+        uint64_t partitioned = 0;  // items passed through a partition or sorting network
+        uint64_t refreshed = 0;    // cache loads, the initial ones included
+    };
+
+    // Thresholds and switches of the engine; loaded from ORASORT_TUNING on
+    // first use. Changes apply to sorts started afterwards.
+    static SortTuning& tuning() {
+        static SortTuning profile = SortTuning::from_environment();
+        return profile;
+    }
+
+    // Kernel used for large partitions; defaults to the tuning profile's
+    // choice or the best one the CPU supports.
+    static PartitionKernel& partition_kernel() {
+        static PartitionKernel kernel = select_partition_kernel(tuning().kernel);
+        return kernel;
+    }
+
+    // Sorts [first, last) by the keys proj projects from the elements (see
+    // orasort_key.hpp), e.g. sort(rows, &Row::key). Items point straight at
+    // terminated keys; other keys are copied into an arena first. The
+    // elements are then moved into sorted order in place.
+    // KeyPadding::Space sorts in SQL PAD SPACE order, without trimming keys:
+    // sort(rows, &Row::name, KeyPadding::Space).
+    template <typename RandomIt, typename Proj = KeyIdentity, typename = enable_if_projection_t<Proj, RandomIt>>
+    static void sort(RandomIt first, RandomIt last, Proj proj = {}, KeyPadding padding = KeyPadding::Zero) {
+        sort_range(first, last, proj, 1, padding);
+    }
+
+    template <typename Range, typename Proj = KeyIdentity, typename = enable_if_range_t<Range>,
+              typename = enable_if_projection_t<Proj, decltype(std::begin(std::declval<Range&>()))>>
+    static void sort(Range& range, Proj proj = {}, KeyPadding padding = KeyPadding::Zero) {
+        sort_range(std::begin(range), std::end(range), proj, 1, padding);
+    }
+
+    // Parallel variants: partitions of tuning().parallel_cutoff items or more
+    // become tasks for a pool of work-stealing threads.
+    template <typename RandomIt, typename Proj, typename = enable_if_projection_t<Proj, RandomIt>>
+    static void sort_parallel(RandomIt first, RandomIt last, Proj proj,
+                              unsigned threads = std::thread::hardware_concurrency(),
+                              KeyPadding padding = KeyPadding::Zero) {
+        sort_range(first, last, proj, threads, padding);
+    }
+
+    template <typename Range, typename Proj, typename = enable_if_range_t<Range>,
+              typename = enable_if_projection_t<Proj, decltype(std::begin(std::declval<Range&>()))>>
+    static void sort_parallel(Range& range, Proj proj, unsigned threads = std::thread::hardware_concurrency(),
+                              KeyPadding padding = KeyPadding::Zero) {
+        sort_range(std::begin(range), std::end(range), proj, threads, padding);
+    }
+
+    template <typename Range, typename = enable_if_range_t<Range>>
+    static void sort_parallel(Range& range, unsigned threads = std::thread::hardware_concurrency()) {
+        KeyIdentity identity;
+        sort_range(std::begin(range), std::end(range), identity, threads, KeyPadding::Zero);
+    }
+
+    // Sorts [first, last) by a primary key and, among equal primary keys, by
+    // a secondary one: sort_composite(events, &Event::user, &Event::time).
+    // No concatenated (primary, secondary) keys are built. The elements are
+    // sorted by primary key, then each run of equal primary keys is sorted by
+    // its secondary keys, the caches starting over at their first byte; the
+    // elements are moved into place once, at the end. Both keys take any
+    // projection (see orasort_key.hpp) and compare under the same padding.
+    template <typename RandomIt, typename Primary, typename Secondary,
+              typename = enable_if_projection_t<Primary, RandomIt>,
+              typename = enable_if_projection_t<Secondary, RandomIt>>
+    static void sort_composite(RandomIt first, RandomIt last, Primary primary, Secondary secondary,
+                               KeyPadding padding = KeyPadding::Zero) {
+        const size_t n = static_cast<size_t>(last - first);
+        if (n < 2) return;
+
+        // Sorting positions keeps the elements still until both passes are done
+        std::vector<size_t> order(n);
+        for (size_t i = 0; i < n; ++i) order[i] = i;
+        auto primary_key = [&](size_t i) -> decltype(auto) { return std::invoke(primary, first[i]); };
+        auto secondary_key = [&](size_t i) -> decltype(auto) { return std::invoke(secondary, first[i]); };
+        sort_range(order.begin(), order.end(), primary_key, 1, padding);
+
+        ORASORT_PHASE(SlowCompare);
+        size_t run = 0;
+        for (size_t k = 1; k <= n; ++k) {
+            if (k < n && compare_views(key_view(primary_key(order[k - 1])), key_view(primary_key(order[k])),
+                                       padding) == 0) {
+                continue;
+            }
+            if (k - run >= kTieSortMin) {
+                sort_range(order.begin() + run, order.begin() + k, secondary_key, 1, padding);
+            } else if (k - run > 1) {
+                std::sort(order.begin() + run, order.begin() + k, [&](size_t a, size_t b) {
+                    return compare_views(key_view(secondary_key(a)), key_view(secondary_key(b)), padding) < 0;
+                });
+            }
+            run = k;
+        }
+        apply_permutation(first, order);
+    }
+
+    template <typename Range, typename Primary, typename Secondary, typename = enable_if_range_t<Range>,
+              typename = enable_if_projection_t<Primary, decltype(std::begin(std::declval<Range&>()))>,
+              typename = enable_if_projection_t<Secondary, decltype(std::begin(std::declval<Range&>()))>>
+    static void sort_composite(Range& range, Primary primary, Secondary secondary,
+                               KeyPadding padding = KeyPadding::Zero) {
+        sort_composite(std::begin(range), std::end(range), primary, secondary, padding);
+    }
+
+    // Sorts with keys compressed by an order-preserving codec. The working set
+    // is the encoded arena: original strings are released while sorting and
+    // rebuilt by decoding in sorted order.
+    static void sort(std::vector<std::string>& data, const KeyCodec& codec) {
+        if (data.empty()) return;
+
+        std::string arena;
+        std::vector<StringItem> items(data.size());
+        {
+            ORASORT_PHASE(CacheBuild);
+            std::vector<size_t> offsets(data.size());
+            for (size_t i = 0; i < data.size(); ++i) {
+                offsets[i] = arena.size();
+                codec.encode(data[i].c_str(), arena);
+                arena.push_back('\0');
+                std::string().swap(data[i]);
+            }
+            for (size_t i = 0; i < data.size(); ++i) {
+                items[i].ptr = arena.data() + offsets[i];
+            }
+        }
+        sort_items(items);
+
+        ORASORT_PHASE(WriteBack);
+        for (size_t i = 0; i < data.size(); ++i) {
+            data[i] = codec.decode(items[i].ptr);
+        }
+    }
+
+    // Sorts items in place by their ptr keys (caches are (re)built here).
+    static void sort_items(std::vector<StringItem>& items, SortStats* stats = nullptr,
+                           KeyPadding padding = KeyPadding::Zero) {
+        if (items.empty()) return;
+
+        SortContext ctx;
+        const int depth = prepare(items, ctx, padding);
+        sort_recursive(items, 0, items.size() - 1, depth, ctx);
+        if (stats) *stats = ctx.stats;
+    }
+
+    static void sort_items_parallel(std::vector<StringItem>& items, unsigned threads, SortStats* stats = nullptr,
+                                    KeyPadding padding = KeyPadding::Zero) {
+        if (items.empty()) return;
+        if (threads <= 1) {
+            sort_items(items, stats, padding);
+            return;
+        }
+
+        SortContext ctx;
+        const int depth = prepare(items, ctx, padding);
+        std::vector<SortTask> roots;
+        if (ctx.tuning.radix_partition_min > 0 && items.size() >= static_cast<size_t>(ctx.tuning.radix_partition_min)) {
+            roots = radix_partition(items, depth, threads, ctx.alpha);
+            ctx.stats.partitioned += items.size();
+        } else {
+            roots.push_back(SortTask{0, static_cast<int>(items.size()) - 1, depth, depth});
+        }
+        TaskPool pool(items, ctx, threads);
+        pool.run(roots);
+        if (stats) *stats = pool.stats();
+    }
+
+    // Rearranges [first, last) like std::nth_element at several ranks at
+    // once: every first[rank] receives the element a sort would put there,
+    // and the elements between two requested ranks end up between their
+    // keys, in no particular order. Only partitions holding a requested rank
+    // are partitioned further, so percentiles or a hundred histogram
+    // boundaries cost a few partition passes rather than a sort. Ranks past
+    // the end are ignored.
+    template <typename RandomIt, typename Proj = KeyIdentity, typename = enable_if_projection_t<Proj, RandomIt>>
+    static void select(RandomIt first, RandomIt last, const std::vector<size_t>& ranks, Proj proj = {},
+                       KeyPadding padding = KeyPadding::Zero) {
+        order_range(first, last, proj, [&](std::vector<StringItem>& items) { select_items(items, ranks, padding); });
+    }
+
+    template <typename Range, typename Proj = KeyIdentity, typename = enable_if_range_t<Range>,
+              typename = enable_if_projection_t<Proj, decltype(std::begin(std::declval<Range&>()))>>
+    static void select(Range& range, const std::vector<size_t>& ranks, Proj proj = {},
+                       KeyPadding padding = KeyPadding::Zero) {
+        select(std::begin(range), std::end(range), ranks, proj, padding);
+    }
+
+    // Selects items in place by their ptr keys (see select()).
+    static void select_items(std::vector<StringItem>& items, std::vector<size_t> ranks,
+                             KeyPadding padding = KeyPadding::Zero) {
+        std::sort(ranks.begin(), ranks.end());
+        ranks.erase(std::lower_bound(ranks.begin(), ranks.end(), items.size()), ranks.end());
+        ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+        if (items.size() < 2 || ranks.empty()) return;
+
+        SortContext ctx;
+        const int depth = prepare(items, ctx, padding);
+        select_recursive(items, 0, static_cast<int>(items.size()) - 1, depth, ranks.data(),
+                         ranks.data() + ranks.size(), ctx);
+    }
+
+    // Nearest-rank positions of the given quantiles (0.5 for the median, 0.99
+    // for p99) among n keys, for select().
+    static std::vector<size_t> quantile_ranks(size_t n, const std::vector<double>& fractions) {
+        std::vector<size_t> ranks;
+        if (n == 0) return ranks;
+        for (double q : fractions) {
+            const double rank = std::ceil(std::min(std::max(q, 0.0), 1.0) * n) - 1;
+            ranks.push_back(rank < 0 ? 0 : static_cast<size_t>(rank));
+        }
+        return ranks;
+    }
+
+    // Distributes [first, last) into the splitters.size() + 1 key ranges the
+    // sorted splitters bound, without sorting within them: range r holds the
+    // keys above splitters[r - 1] and up to splitters[r] (the first range is
+    // open below, the last above). This is the map side of a sort-based
+    // shuffle. Elements keep their input order within a range. Returns the
+    // range offsets: range r is [first + offsets[r], first + offsets[r + 1]).
+    template <typename RandomIt, typename Proj = KeyIdentity, typename = enable_if_projection_t<Proj, RandomIt>>
+    static std::vector<size_t> partition_ranges(RandomIt first, RandomIt last, const std::vector<std::string>& splitters,
+                                                Proj proj = {}, unsigned threads = 1) {
+        std::vector<size_t> offsets(splitters.size() + 2, 0);
+        order_range(first, last, proj,
+                    [&](std::vector<StringItem>& items) { offsets = partition_items(items, splitters, threads); });
+        return offsets;
+    }
+
+    template <typename Range, typename Proj = KeyIdentity, typename = enable_if_range_t<Range>,
+              typename = enable_if_projection_t<Proj, decltype(std::begin(std::declval<Range&>()))>>
+    static std::vector<size_t> partition_ranges(Range& range, const std::vector<std::string>& splitters,
+                                                Proj proj = {}, unsigned threads = 1) {
+        return partition_ranges(std::begin(range), std::end(range), splitters, proj, threads);
+    }
+
+    // Distributes items by their ptr keys (see partition_ranges()). Each
+    // thread classifies a slice of the items and then scatters it.
+    static std::vector<size_t> partition_items(std::vector<StringItem>& items, const std::vector<std::string>& splitters,
+                                               unsigned threads = 1) {
+        ORASORT_PHASE(Partition);
+        TraceSpan span("range partition", "sort", items.size());
+        const size_t n = items.size();
+        const size_t ranges = splitters.size() + 1;
+        threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, n / kRangeSliceMin)));
+        const SplitterTree tree(splitters);
+        auto parallel = [threads](const auto& body) {
+            std::vector<std::thread> workers;
+            for (unsigned t = 1; t < threads; ++t) workers.emplace_back([&body, t] { body(t); });
+            body(0u);
+            for (auto& w : workers) w.join();
+        };
+
+        std::vector<uint32_t> range_of(n);
+        std::vector<std::vector<size_t>> next(threads, std::vector<size_t>(ranges, 0));
+        parallel([&](unsigned t) {
+            for (size_t i = n * t / threads; i < n * (t + 1) / threads; ++i) {
+                range_of[i] = static_cast<uint32_t>(tree.classify(items[i].ptr));
+                next[t][range_of[i]]++;
+            }
+        });
+        std::vector<size_t> offsets(ranges + 1);
+        size_t pos = 0;
+        for (size_t r = 0; r < ranges; ++r) {
+            offsets[r] = pos;
+            for (unsigned t = 0; t < threads; ++t) {
+                const size_t count = next[t][r];
+                next[t][r] = pos;
+                pos += count;
+            }
+        }
+        offsets[ranges] = pos;
+
+        std::vector<StringItem> out(n);
+        parallel([&](unsigned t) {
+            for (size_t i = n * t / threads; i < n * (t + 1) / threads; ++i) out[next[t][range_of[i]]++] = items[i];
+        });
+        items.swap(out);
+        return offsets;
+    }
+
+private:
+    // Capacity of the sorting network; tuning().network_max picks the size used.
+    static const int kNetworkMax = 64;
+
+    class TaskPool;
+
+    // Per-sort (per-worker in parallel sorts) state threaded through the recursion.
+    struct SortContext {
+        SortTuning tuning;                // copied once per sort: the hot paths read no statics
+        KeyAlphabet alpha;
+        PartitionKernel kernel;
+        std::vector<StringItem> scratch;  // out-of-place buffer of the three-way partition
+        std::vector<uint8_t> oracle;      // bucket of each item in a sample sort step
+        std::vector<uint16_t> labels;     // bucket of each item in a learned distribution step
+        uint64_t rng = 0x9E3779B97F4A7C15ULL;  // pivot selection (rand() is locked and shared)
+        TaskPool* pool = nullptr;         // set in parallel sorts
+        unsigned worker = 0;              // index of this context's worker in the pool
+        SortStats stats;
+
+        int random(int range) {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            return static_cast<int>(rng % static_cast<uint64_t>(range));
+        }
+    };
+
+    // Detects the key alphabet, skips the prefix shared by all keys and
+    // caches the first word at that depth. Returns the depth.
+    static int prepare(std::vector<StringItem>& items, SortContext& ctx, KeyPadding padding) {
+        ORASORT_PHASE(CacheBuild);
+        ctx.tuning = tuning();
+        ctx.tuning.network_max = std::min(ctx.tuning.network_max, static_cast<int>(kNetworkMax));
+        ctx.alpha = ctx.tuning.reduce_alphabet ? KeyAlphabet::analyze(items, padding) : KeyAlphabet::identity(padding);
+        ctx.kernel = partition_kernel();
+        if (ctx.kernel != PartitionKernel::Scalar) ctx.scratch.resize(items.size());
+        int depth = 0;
+        {
+            ORASORT_PHASE(PrefixScan);
+            depth = global_common_prefix(items, ctx.kernel);
+        }
+        refresh_items(items, 0, static_cast<int>(items.size()) - 1, depth, ctx);
+        return depth;
+    }
+
+    template <typename RandomIt, typename Proj>
+    static void sort_range(RandomIt first, RandomIt last, Proj& proj, unsigned threads, KeyPadding padding) {
+        if (last - first < 2) return;
+        order_range(first, last, proj,
+                    [&](std::vector<StringItem>& items) { sort_items_parallel(items, threads, nullptr, padding); });
+    }
+
+    // Runs of equal primary keys this long are sorted by sort_composite()
+    // through the items; shorter ones by plain comparisons.
+    static constexpr size_t kTieSortMin = 32;
+
+    // Three-way comparison of two keys as the sort orders them: as unsigned
+    // bytes, a proper prefix first, or under PAD SPACE as if the shorter key
+    // were padded with spaces.
+    static int compare_views(std::string_view a, std::string_view b, KeyPadding padding) {
+        const size_t common = std::min(a.size(), b.size());
+        if (common > 0) {
+            const int c = std::memcmp(a.data(), b.data(), common);
+            if (c != 0) return c;
+        }
+        if (a.size() == b.size()) return 0;
+        const int sign = a.size() < b.size() ? -1 : 1;
+        if (padding == KeyPadding::Zero) return sign;
+        const std::string_view tail = a.size() < b.size() ? b.substr(common) : a.substr(common);
+        for (unsigned char c : tail) {
+            if (c != ' ') return c < ' ' ? -sign : sign;
+        }
+        return 0;
+    }
+
+    // Builds the items of [first, last), lets arrange reorder them and moves
+    // the elements into their order.
+    template <typename RandomIt, typename Proj, typename Arrange>
+    static void order_range(RandomIt first, RandomIt last, Proj& proj, Arrange arrange) {
+        using Key = projected_key_t<Proj, RandomIt>;
+        const size_t n = static_cast<size_t>(last - first);
+        if (n == 0) return;
+
+        std::vector<StringItem> items(n);
+        std::string arena;  // terminated copies of keys that come without a terminator
+        {
+            ORASORT_PHASE(CacheBuild);
+            if constexpr (is_terminated_key_v<Key>) {
+                for (size_t i = 0; i < n; ++i) items[i].ptr = key_c_str(std::invoke(proj, first[i]));
+            } else {
+                std::vector<size_t> offsets(n);
+                for (size_t i = 0; i < n; ++i) {
+                    const auto& key = std::invoke(proj, first[i]);  // keeps a returned temporary alive
+                    const std::string_view view = key_view(key);
+                    offsets[i] = arena.size();
+                    arena.append(view.data(), view.size());
+                    arena.push_back('\0');
+                }
+                for (size_t i = 0; i < n; ++i) items[i].ptr = arena.data() + offsets[i];
+            }
+        }
+
+        KeyOrigins origins(items);
+        arrange(items);
+        write_back(first, items, origins);
+    }
+
+    // Maps key addresses back to the indices of their elements: an open
+    // addressing table of distinct addresses, twice the item count, each
+    // heading a chain of the elements sharing it (const char* keys pointing
+    // at one literal). take() pops the chain in element order, so repeated
+    // addresses cost O(1) each and keep their input order.
+    class KeyOrigins {
+    public:
+        explicit KeyOrigins(const std::vector<StringItem>& items) : next_(items.size()) {
+            size_t capacity = 2;
+            while (capacity < 2 * items.size()) capacity <<= 1, shift_--;
+            slots_.assign(capacity, Slot{nullptr, kEnd});
+            for (size_t i = items.size(); i-- > 0;) {
+                Slot& slot = find(items[i].ptr);
+                slot.ptr = items[i].ptr;
+                next_[i] = slot.head;
+                slot.head = i;
+            }
+        }
+
+        size_t take(const char* ptr) {
+            Slot& slot = find(ptr);
+            const size_t index = slot.head;
+            slot.head = next_[index];
+            return index;
+        }
+
+    private:
+        struct Slot {
+            const char* ptr;
+            size_t head;  // first untaken element with this address
+        };
+        static constexpr size_t kEnd = ~size_t(0);
+
+        Slot& find(const char* ptr) {
+            size_t h = static_cast<size_t>((reinterpret_cast<uintptr_t>(ptr) * 0x9E3779B97F4A7C15ULL) >> shift_);
+            while (slots_[h].ptr && slots_[h].ptr != ptr) h = (h + 1) & (slots_.size() - 1);
+            return slots_[h];
+        }
+
+        std::vector<Slot> slots_;
+        std::vector<size_t> next_;  // next element sharing the address, or kEnd
+        int shift_ = 63;
+    };
+
+    // Moves the elements into the order of the sorted items.
+    template <typename RandomIt>
+    static void write_back(RandomIt first, const std::vector<StringItem>& items, KeyOrigins& origins) {
+        ORASORT_PHASE(WriteBack);
+        TraceSpan span("write-back", "sort", items.size());
+        std::vector<size_t> order(items.size());  // order[k]: original index of the element going to position k
+        for (size_t k = 0; k < items.size(); ++k) order[k] = origins.take(items[k].ptr);
+        apply_permutation(first, order);
+    }
+
+    // --- Range Partition ---
+    // The splitters form an implicit binary search tree (children of node n
+    // at 2n and 2n + 1), padded to a full tree with copies of the largest.
+    // A key reaching a node lies between the two splitters bounding the
+    // node's subtree, so it shares their common prefix: each node compares
+    // the cache word of the key at that depth against the splitter's word
+    // there, and only equal words read on. The key's word is reloaded only
+    // when the depth grows on the way down.
+    static const size_t kRangeSliceMin = 1 << 14;  // fewest items per partitioning thread
+
+    class SplitterTree {
+    public:
+        explicit SplitterTree(const std::vector<std::string>& splitters)
+            : count_(static_cast<int>(splitters.size())) {
+            while ((1 << levels_) - 1 < count_) levels_++;
+            const int nodes = 1 << levels_;
+            sorted_.resize(nodes - 1);
+            for (int i = 0; i < nodes - 1; ++i) sorted_[i] = splitters[std::min(i, count_ - 1)].c_str();
+            key_.resize(nodes);
+            depth_.resize(nodes);
+            word_.resize(nodes);
+            build(1, 0, nodes - 1, 0);
+        }
+
+        // The number of splitters below key.
+        int classify(const char* key) const {
+            ORASORT_COMPARE(levels_);
+            int node = 1;
+            int depth = -1;
+            uint64_t word = 0;
+            for (int l = 0; l < levels_; ++l) {
+                if (depth_[node] != depth) {
+                    depth = depth_[node];
+                    word = load_bytes_be(key + depth);
+                }
+                bool above;
+                if (word != word_[node]) {
+                    above = word > word_[node];
+                } else if ((word & 0xFF) == 0) {
+                    above = false;  // both end inside the word: equal
+                } else {
+                    ORASORT_PHASE(SlowCompare);
+                    above = std::strcmp(key + depth + 8, key_[node] + depth + 8) > 0;
+                }
+                node = 2 * node + static_cast<int>(above);
+            }
+            return std::min(node - (1 << levels_), count_);
+        }
+
+    private:
+        int count_;
+        int levels_ = 0;
+        std::vector<const char*> sorted_;  // the splitters, padded
+        std::vector<const char*> key_;     // per node: its splitter
+        std::vector<int> depth_;           // per node: bytes shared by every key reaching it
+        std::vector<uint64_t> word_;       // per node: splitter bytes [depth, depth + 8)
+
+        // Stores sorted_[lo, hi) below node; the keys reaching it share depth bytes.
+        void build(int node, int lo, int hi, int depth) {
+            if (lo >= hi) return;
+            const int mid = (lo + hi) / 2;
+            key_[node] = sorted_[mid];
+            depth_[node] = depth;
+            word_[node] = load_bytes_be(sorted_[mid] + depth);
+            build(2 * node, lo, mid, lo > 0 ? common_prefix(sorted_[lo - 1], sorted_[mid]) : 0);
+            build(2 * node + 1, mid + 1, hi,
+                  hi < static_cast<int>(sorted_.size()) ? common_prefix(sorted_[mid], sorted_[hi]) : 0);
+        }
+
+        static int common_prefix(const char* a, const char* b) {
+            int k = 0;
+            while (a[k] && a[k] == b[k]) k++;
+            return k;
+        }
+    };
+
+    // --- Parallel Sort ---
+    // A task is a partition whose caches are valid at depth and which is to
+    // be sorted at new_depth. Each worker owns a deque: it pushes and pops at
+    // the back (depth first, warm caches) and steals from the front of the
+    // others, where the oldest and largest tasks are.
+    struct SortTask {
+        int low, high, depth, new_depth;
+    };
+
+    class TaskPool {
+    public:
+        TaskPool(std::vector<StringItem>& arr, SortContext& proto, unsigned threads)
+            : arr_(arr), workers_(threads) {
+            for (unsigned w = 0; w < threads; ++w) {
+                SortContext& ctx = workers_[w].ctx;
+                ctx.tuning = proto.tuning;
+                ctx.alpha = proto.alpha;
+                ctx.kernel = proto.kernel;
+                ctx.rng = proto.rng + w;
+                ctx.pool = this;
+                ctx.worker = w;
+            }
+            // The first task covers the whole input: give its scratch to worker 0.
+            workers_[0].ctx.scratch = std::move(proto.scratch);
+            workers_[0].ctx.stats = proto.stats;
+        }
+
+        // Sorts the root tasks, dealt round robin; the calling thread acts as worker 0.
+        void run(const std::vector<SortTask>& roots) {
+            for (size_t r = 0; r < roots.size(); ++r) push(roots[r], static_cast<unsigned>(r % workers_.size()));
+            std::vector<std::thread> threads;
+            for (unsigned w = 1; w < workers_.size(); ++w) {
+                threads.emplace_back([this, w] { work(w); });
+            }
+            work(0);
+            for (auto& t : threads) t.join();
+        }
+
+        SortStats stats() const {
+            SortStats total;
+            for (const auto& worker : workers_) {
+                total.partitioned += worker.ctx.stats.partitioned;
+                total.refreshed += worker.ctx.stats.refreshed;
+            }
+            return total;
+        }
+
+        void push(const SortTask& task, unsigned worker) {
+            pending_.fetch_add(1, std::memory_order_relaxed);
+            Worker& self = workers_[worker];
+            std::lock_guard<std::mutex> lock(self.mutex);
+            self.tasks.push_back(task);
+        }
+
+    private:
+        struct Worker {
+            std::mutex mutex;
+            std::deque<SortTask> tasks;
+            SortContext ctx;
+        };
+
+        std::vector<StringItem>& arr_;
+        std::vector<Worker> workers_;
+        std::atomic<long> pending_{0};  // pushed but not yet finished tasks
+
+        void work(unsigned w) {
+            // Naming a thread allocates its trace buffer: only when tracing.
+            if (TraceRecorder::instance().enabled()) {
+                TraceRecorder::instance().set_thread_name("sort worker " + std::to_string(w));
+            }
+            SortTask task;
+            while (pending_.load(std::memory_order_acquire) > 0) {
+                if (pop(w, task) || steal(w, task)) {
+                    execute(w, task);
+                    pending_.fetch_sub(1, std::memory_order_acq_rel);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        bool pop(unsigned w, SortTask& task) {
+            Worker& self = workers_[w];
+            std::lock_guard<std::mutex> lock(self.mutex);
+            if (self.tasks.empty()) return false;
+            task = self.tasks.back();
+            self.tasks.pop_back();
+            return true;
+        }
+
+        bool steal(unsigned w, SortTask& task) {
+            for (unsigned k = 1; k < workers_.size(); ++k) {
+                Worker& victim = workers_[(w + k) % workers_.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (victim.tasks.empty()) continue;
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                if (TraceRecorder::instance().enabled()) {
+                    TraceRecorder::instance().instant("steal", "sched", task.high - task.low + 1);
+                }
+                return true;
+            }
+            return false;
+        }
+
+        void execute(unsigned w, const SortTask& task) {
+            TraceSpan span("partition task", "sort", task.high - task.low + 1);
+            SortContext& ctx = workers_[w].ctx;
+            refresh_range(arr_, task.low, task.high, task.depth, task.new_depth, ctx);
+            sort_recursive(arr_, task.low, task.high, task.new_depth, ctx);
+        }
+    };
+
+    // --- Parallel Radix Partition ---
+    // On huge inputs the first partitions are sorted by one thread each while
+    // the others wait for tasks. Such inputs are split first, in place, into
+    // buckets by their next symbol (the top of the cache word), PARADIS style:
+    //
+    //  1. Histogram: threads count the symbols of slices of the input.
+    //  2. Speculative permutation: the unfinished part of every bucket is cut
+    //     into one stripe per thread. Each thread moves items between its own
+    //     stripes by cycle leader; an item whose target stripe is full stays
+    //     where it is, misplaced.
+    //  3. Repair: per bucket, the items belonging there are swapped to its
+    //     front; the misplaced rest is its unfinished part for the next round.
+    //
+    // Rounds repeat while thousands of items per thread are unfinished and
+    // each round at least halves them; one sequential cycle leader over the
+    // rest finishes. Extra memory: a few
+    // tables of one entry per symbol and thread. The buckets become the root
+    // tasks of the task pool.
+    static std::vector<SortTask> radix_partition(std::vector<StringItem>& arr, int depth, unsigned threads,
+                                                 const KeyAlphabet& alpha) {
+        ORASORT_PHASE(Partition);
+        TraceSpan span("radix partition", "sort", arr.size());
+        const int shift = 64 - alpha.bits;
+        const int buckets = 1 << alpha.bits;
+        const size_t n = arr.size();
+        StringItem* a = arr.data();
+        auto digit = [shift](const StringItem& item) { return static_cast<int>(item.cache >> shift); };
+        auto parallel = [threads](const auto& body) {
+            std::vector<std::thread> workers;
+            for (unsigned t = 1; t < threads; ++t) workers.emplace_back([&body, t] { body(t); });
+            body(0u);
+            for (auto& w : workers) w.join();
+        };
+        // Cycle leader over the ranges [head[b], end[b]), which must hold
+        // end[b] - head[b] items of every symbol b once finished.
+        auto permute = [&](size_t* head, const size_t* end) {
+            for (int b = 0; b < buckets; ++b) {
+                while (head[b] < end[b]) {
+                    StringItem v = a[head[b]];
+                    int k = digit(v);
+                    while (k != b && head[k] < end[k]) {
+                        std::swap(v, a[head[k]++]);
+                        k = digit(v);
+                    }
+                    a[head[b]++] = v;
+                }
+            }
+        };
+
+        std::vector<std::vector<size_t>> counts(threads, std::vector<size_t>(buckets, 0));
+        parallel([&](unsigned t) {
+            for (size_t i = n * t / threads; i < n * (t + 1) / threads; ++i) counts[t][digit(a[i])]++;
+        });
+        std::vector<size_t> start(buckets), head(buckets), tail(buckets);
+        size_t pos = 0;
+        for (int b = 0; b < buckets; ++b) {
+            start[b] = head[b] = pos;
+            for (unsigned t = 0; t < threads; ++t) pos += counts[t][b];
+            tail[b] = pos;
+        }
+
+        std::vector<std::vector<size_t>> stripe_head(threads, std::vector<size_t>(buckets));
+        std::vector<std::vector<size_t>> stripe_end(threads, std::vector<size_t>(buckets));
+        size_t remaining = n;
+        while (remaining > 1024 * static_cast<size_t>(threads)) {
+            for (int b = 0; b < buckets; ++b) {
+                const size_t len = tail[b] - head[b];
+                for (unsigned t = 0; t < threads; ++t) {
+                    stripe_head[t][b] = head[b] + len * t / threads;
+                    stripe_end[t][b] = head[b] + len * (t + 1) / threads;
+                }
+            }
+            parallel([&](unsigned t) { permute(stripe_head[t].data(), stripe_end[t].data()); });
+            parallel([&](unsigned t) {
+                for (int b = static_cast<int>(t); b < buckets; b += static_cast<int>(threads)) {
+                    size_t i = head[b], j = tail[b];
+                    while (true) {
+                        while (i < j && digit(a[i]) == b) ++i;
+                        while (i < j && digit(a[j - 1]) != b) --j;
+                        if (i >= j) break;
+                        std::swap(a[i++], a[--j]);
+                    }
+                    head[b] = i;
+                }
+            });
+            const size_t before = remaining;
+            remaining = 0;
+            for (int b = 0; b < buckets; ++b) remaining += tail[b] - head[b];
+            if (remaining * 2 > before) break;
+        }
+        if (remaining > 0) permute(head.data(), tail.data());
+
+        // Keys in the bucket of the end code all end here and are equal; under
+        // space padding that bucket holds real spaces too and keeps its depth.
+        const int end_digit = static_cast<int>(alpha.pad_word >> shift);
+        std::vector<SortTask> tasks;
+        for (int b = 0; b < buckets; ++b) {
+            if (tail[b] - start[b] < 2) continue;
+            const int low = static_cast<int>(start[b]), high = static_cast<int>(tail[b]) - 1;
+            if (b != end_digit) {
+                tasks.push_back(SortTask{low, high, depth, depth + 1});
+            } else if (alpha.pads_spaces()) {
+                tasks.push_back(SortTask{low, high, depth, depth});
+            }
+        }
+        return tasks;
+    }
+
+    // --- Global Common Prefix ---
+    // Inputs often share tens of leading bytes ("s3://bucket-name/tenant/...").
+    // Measuring that prefix once against the first key, 32 bytes per step,
+    // lets the first partition start at the true initial depth instead of
+    // discovering it one cache word at a time.
+    static int global_common_prefix(const std::vector<StringItem>& items, PartitionKernel kernel) {
+        const char* ref = items[0].ptr;
+        size_t common = strlen(ref);
+        ORASORT_INSPECT(common);
+        for (size_t i = 1; i < items.size() && common > 0; ++i) {
+            const size_t limit = common;
+#if ORASORT_X86_SIMD
+            if (kernel != PartitionKernel::Scalar) {
+                common = shared_prefix_avx2(ref, items[i].ptr, limit);
+                ORASORT_INSPECT(2 * std::min(common + 1, limit));
+                continue;
+            }
+#endif
+            size_t k = 0;
+            while (k < limit && ref[k] == items[i].ptr[k]) k++;
+            common = k;
+            ORASORT_INSPECT(2 * std::min(common + 1, limit));
+        }
+        (void)kernel;
+        return static_cast<int>(common);
+    }
+
+#if ORASORT_X86_SIMD
+    // Bytes shared by a and b, at most limit (a has no terminator before limit).
+    // b may be shorter: its terminator shows up as a mismatch. A 32-byte load of
+    // b can run past its end but never into the next page, like a vector strlen.
+    __attribute__((target("avx2"), no_sanitize("address")))
+    static size_t shared_prefix_avx2(const char* a, const char* b, size_t limit) {
+        size_t k = 0;
+        while (k + 32 <= limit) {
+            if ((reinterpret_cast<uintptr_t>(b + k) & 4095) > 4096 - 32) {
+                for (size_t stop = k + 32; k < stop; ++k) {
+                    if (a[k] != b[k]) return k;
+                }
+                continue;
+            }
+            const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + k));
+            const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + k));
+            const unsigned eq = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+            if (eq != 0xFFFFFFFFu) return k + __builtin_ctz(~eq);
+            k += 32;
+        }
+        while (k < limit && a[k] == b[k]) k++;
+        return k;
+    }
+#endif
+
+    // Returns: <0 if s1 < s2, >0 if s1 > s2, 0 if equal
+    // Updates: match_len_out with the number of matching symbols from depth on
+    static int compare_and_count(const StringItem& a, const StringItem& b, int depth, int& match_len_out,
+                                 const KeyAlphabet& alpha) {
+        ORASORT_COMPARE(1);
+        // 1. Fast Path: Compare Caches
+        if (a.cache != b.cache) {
+            // Count matching leading zeros (clz) in XOR to find matching bits,
+            // divide by the symbol width to get matching symbols.
+            uint64_t diff = a.cache ^ b.cache;
+            match_len_out = alpha.unpadded(a.cache, __builtin_clzll(diff) / alpha.bits);
+            return (a.cache < b.cache) ? -1 : 1;
+        }
+        if (alpha.pads_spaces()) return compare_padded(a, b, depth, match_len_out, alpha);
+
+        // 2. Caches are equal and both strings end inside the cached window:
+        // the strings are identical.
+        if (alpha.ends_in(a.cache)) {
+            match_len_out = static_cast<int>(strlen(a.ptr + depth));
+            ORASORT_INSPECT(match_len_out);
+            return 0;
+        }
+
+        // 3. Slow Path: all cached symbols match.
+        // Scan remaining characters. The code is monotone, so raw bytes order the same way.
+        ORASORT_PHASE(SlowCompare);
+        const char* s1 = a.ptr + depth + alpha.symbols;
+        const char* s2 = b.ptr + depth + alpha.symbols;
+        int k = 0;
+        while (s1[k] && s2[k] && s1[k] == s2[k]) {
+            k++;
+        }
+        
+        ORASORT_INSPECT(2 * (k + 1));
+        match_len_out = alpha.symbols + k; // symbols from cache + k from scan
+        return (unsigned char)s1[k] - (unsigned char)s2[k];
+    }
+
+    // Equal caches under space padding: the cached symbols before the
+    // trailing spaces are real in both keys; from there on the keys are
+    // scanned, and once one ends the rest of the other is compared with spaces.
+    static int compare_padded(const StringItem& a, const StringItem& b, int depth, int& match_len_out,
+                              const KeyAlphabet& alpha) {
+        ORASORT_PHASE(SlowCompare);
+        const unsigned char* s1 = reinterpret_cast<const unsigned char*>(a.ptr + depth);
+        const unsigned char* s2 = reinterpret_cast<const unsigned char*>(b.ptr + depth);
+        int k = alpha.unpadded(a.cache, alpha.symbols);
+        while (s1[k] && s1[k] == s2[k]) k++;
+        ORASORT_INSPECT(2 * (k + 1));
+        match_len_out = k;
+        if (s1[k] && s2[k]) return s1[k] - s2[k];
+
+        // One key ended: the first non-space of the other decides.
+        const unsigned char* rest = s1[k] ? s1 + k : s2 + k;
+        while (*rest == ' ') rest++;
+        ORASORT_INSPECT(rest - (s1[k] ? s1 + k : s2 + k));
+        if (!*rest) return 0;
+        const int sign = (*rest < ' ') ? -1 : 1;
+        return s1[k] ? sign : -sign;
+    }
+
+    static void sort_recursive(std::vector<StringItem>& arr, int low, int high, int depth, SortContext& ctx) {
+        if (low >= high) return;
+        ctx.stats.partitioned += high - low + 1;
+
+#if ORASORT_X86_SIMD
+        // Small partitions on SIMD capable CPUs are sorted by a network.
+        if (ctx.kernel != PartitionKernel::Scalar && high - low + 1 <= ctx.tuning.network_max) {
+            sort_small_network(arr, low, high, depth, ctx);
+            return;
+        }
+#endif
+
+        // Large partitions are split into many buckets at once: by a learned
+        // model of the key distribution where it fits, else by samples.
+        if (ctx.tuning.learned_sort_min > 0 && high - low + 1 >= ctx.tuning.learned_sort_min &&
+            learned_sort_step(arr, low, high, depth, ctx)) {
+            return;
+        }
+        if (ctx.tuning.sample_sort_min > 0 && high - low + 1 >= ctx.tuning.sample_sort_min) {
+            sample_sort_step(arr, low, high, depth, ctx);
+            return;
+        }
+
+        // Phases nest with the recursion; the profiler charges each level exclusively.
+        ORASORT_PHASE(Partition);
+
+        // Pivot Selection (Median of 3 recommended, using random for brevity)
+        int pivot_idx = low + ctx.random(high - low + 1);
+        std::swap(arr[low], arr[pivot_idx]);
+        StringItem pivot = arr[low]; 
+
+        // Large partitions on SIMD capable CPUs take the vectorized three-way partition.
+        if (ctx.kernel != PartitionKernel::Scalar && high - low + 1 >= ctx.tuning.vector_partition_min) {
+            partition_three_way(arr, low, high, depth, pivot, ctx);
+            return;
+        }
+
+        int new_depth = depth;
+        const int j = hoare_partition(arr, low, high, depth, new_depth, ctx);
+        recurse(arr, low, j - 1, depth, new_depth, ctx);
+        recurse(arr, j + 1, high, depth, new_depth, ctx);
+    }
+
+    // Partitions arr[low..high] around the pivot at arr[low] and returns the
+    // pivot's final position j: arr[low..j-1] <= pivot <= arr[j+1..high].
+    // new_depth receives the depth all of them still share.
+    static int hoare_partition(std::vector<StringItem>& arr, int low, int high, int depth, int& new_depth,
+                               SortContext& ctx) {
+        const KeyAlphabet& alpha = ctx.alpha;
+        int min_common_with_pivot = INT_MAX;
+        const int j = hoare_partition_items(arr.data(), low, high, min_common_with_pivot,
+                                            [&](const StringItem& a, const StringItem& b, int& match_len) {
+                                                return compare_and_count(a, b, depth, match_len, alpha);
+                                            });
+
+        // min_common_with_pivot now holds the number of bytes that *every* string in this range
+        // shares with the pivot. Consequently, they all share that many bytes with each other.
+        // We can safely increment the depth by this amount for the next recursion.
+        new_depth = depth + min_common_with_pivot;
+        return j;
+    }
+
+    // The partition loop itself, for any item type: compare(a, b, match_len)
+    // returns <0, 0 or >0 and the symbols a and b share from the current
+    // depth on. min_common is lowered to the least match with the pivot.
+    // SymbolOrasort partitions its wide-symbol items with it too.
+    template <typename Item, typename Count, typename Compare>
+    static int hoare_partition_items(Item* arr, int low, int high, Count& min_common, Compare compare) {
+        const Item pivot = arr[low];
+        int i = low + 1;
+        int j = high;
+
+        // --- Partitioning with Integrated Prefix Scan ---
+        // We use a standard Hoare-like partition but perform prefix counting simultaneously.
+        while (true) {
+            // Scan i right
+            while (i <= j) {
+                Count match_len = 0;
+                const int cmp = compare(arr[i], pivot, match_len);
+                if (match_len < min_common) min_common = match_len;
+                if (cmp >= 0) break; // Found element >= pivot, stop
+                i++;
+            }
+
+            // Scan j left
+            while (i <= j) {
+                Count match_len = 0;
+                const int cmp = compare(arr[j], pivot, match_len);
+                if (match_len < min_common) min_common = match_len;
+                if (cmp <= 0) break; // Found element <= pivot, stop
+                j--;
+            }
+
+            if (i <= j) {
+                std::swap(arr[i], arr[j]);
+                i++;
+                j--;
+            } else {
+                break;
+            }
+        }
+
+        // Restore pivot
+        std::swap(arr[low], arr[j]);
+
+        // At this point:
+        // arr[low..j-1] are <= pivot
+        // arr[j] is pivot
+        // arr[j+1..high] are >= pivot
+        return j;
+    }
+
+    // Partitions no smaller than this are split further by select(); smaller
+    // ones holding a requested rank are simply sorted.
+    static const int kSelectSortMax = 32;
+
+    // Puts the items of ranks [rank, rank_end) (ascending, within
+    // arr[low..high], caches valid at depth) into their sorted positions.
+    // Only the side of each partition that holds a rank is descended into.
+    static void select_recursive(std::vector<StringItem>& arr, int low, int high, int depth, const size_t* rank,
+                                 const size_t* rank_end, SortContext& ctx) {
+        while (low < high) {
+            if (high - low + 1 <= kSelectSortMax) {
+                sort_recursive(arr, low, high, depth, ctx);
+                return;
+            }
+            ctx.stats.partitioned += high - low + 1;
+            if (ctx.tuning.sample_sort_min > 0 && high - low + 1 >= ctx.tuning.sample_sort_min) {
+                select_split(arr, low, high, depth, rank, rank_end, ctx);
+                return;
+            }
+            int j = 0, new_depth = depth;
+            {
+                ORASORT_PHASE(Partition);
+                std::swap(arr[low], arr[low + ctx.random(high - low + 1)]);
+                j = hoare_partition(arr, low, high, depth, new_depth, ctx);
+            }
+            const size_t* split = std::lower_bound(rank, rank_end, static_cast<size_t>(j));
+            if (split != rank && low < j - 1) {
+                refresh_range(arr, low, j - 1, depth, new_depth, ctx);
+                select_recursive(arr, low, j - 1, new_depth, rank, split, ctx);
+            }
+            if (split != rank_end && *split == static_cast<size_t>(j)) split++;
+            if (split == rank_end) return;
+            refresh_range(arr, j + 1, high, depth, new_depth, ctx);
+            low = j + 1;
+            depth = new_depth;
+            rank = split;
+        }
+    }
+
+    // Large partitions take one sample sort distribution; only the buckets
+    // holding a rank are descended into.
+    static void select_split(std::vector<StringItem>& arr, int low, int high, int depth, const size_t* rank,
+                             const size_t* rank_end, SortContext& ctx) {
+        std::vector<SplitBucket> buckets;
+        sample_split(arr, low, high, depth, ctx, buckets);
+        const KeyAlphabet& alpha = ctx.alpha;
+        for (const SplitBucket& b : buckets) {
+            rank = std::lower_bound(rank, rank_end, static_cast<size_t>(b.low));
+            const size_t* end = std::upper_bound(rank, rank_end, static_cast<size_t>(b.high));
+            if (rank == end) continue;
+            if (!b.equal) {
+                refresh_range(arr, b.low, b.high, depth, b.new_depth, ctx);
+                select_recursive(arr, b.low, b.high, b.new_depth, rank, end, ctx);
+            } else if (alpha.pads_spaces() ? alpha.unpadded(b.cache, alpha.symbols) == alpha.symbols
+                                           : !alpha.ends_in(b.cache)) {
+                refresh_range(arr, b.low, b.high, depth, depth + alpha.symbols, ctx);
+                select_recursive(arr, b.low, b.high, depth + alpha.symbols, rank, end, ctx);
+            } else {
+                recurse_equal(arr, b.low, b.high, depth, b.cache, ctx);  // identical keys, or padded ones
+            }
+            rank = end;
+        }
+    }
+
+    // Sorts arr[low..high], whose caches are valid for depth, at new_depth.
+    // In parallel sorts large ranges become tasks instead (refreshed by the worker running them).
+    static void recurse(std::vector<StringItem>& arr, int low, int high, int depth, int new_depth, SortContext& ctx) {
+        if (low >= high) return;
+
+        if (ctx.pool && high - low + 1 >= ctx.tuning.parallel_cutoff) {
+            ctx.pool->push(SortTask{low, high, depth, new_depth}, ctx.worker);
+            return;
+        }
+        refresh_range(arr, low, high, depth, new_depth, ctx);
+        sort_recursive(arr, low, high, new_depth, ctx);
+    }
+
+    // Lazy Update: The cache for 'depth' is valid, but for 'new_depth' it is not.
+    // We must update the cache for the sub-range. This is the cost of caching.
+    static void refresh_range(std::vector<StringItem>& arr, int low, int high, int depth, int new_depth,
+                              SortContext& ctx) {
+        if (new_depth > depth) {
+            ORASORT_PHASE(RefreshCache);
+            refresh_items(arr, low, high, new_depth, ctx);
+        }
+    }
+
+    // Reloads the caches of arr[low..high] at depth. The key loads go to
+    // random addresses; with a prefetch distance the keys of later items are
+    // requested while earlier ones are loaded.
+    static void refresh_items(std::vector<StringItem>& arr, int low, int high, int depth, SortContext& ctx) {
+        const int distance = ctx.tuning.prefetch_distance;
+        for (int k = low; k <= high; k++) {
+            if (distance && k + distance <= high) __builtin_prefetch(arr[k + distance].ptr + depth);
+            arr[k].refresh_cache(depth, ctx.alpha);
+        }
+        ctx.stats.refreshed += high - low + 1;
+    }
+
+    // --- Super-Scalar Sample Sort Step ---
+    // One step splits a partition into up to 255 buckets instead of three.
+    // Splitters are cache words drawn from a random sample and kept as an
+    // implicit binary tree: an item descends it without branches, and items
+    // are classified eight at a time so that the descents overlap. Splitter
+    // i has an equality bucket: its items share the whole cache word and go
+    // on a word deeper. The items between two splitters share the symbols
+    // the two splitters share, so every bucket starts at its own depth.
+    //
+    // Items are distributed in place by cycle leader, guided by a one byte
+    // bucket oracle per item. The buckets are then recursed into (or handed
+    // to the task pool).
+    static const int kSampleLevels = 7;  // tree depth: up to 127 splitters
+    static const int kOversample = 16;   // sample items per splitter
+
+    // A bucket left by a distribution step: arr[low..high] sharing symbols
+    // up to new_depth, or, if equal, all with the cache word cache.
+    struct SplitBucket {
+        int low, high;
+        int new_depth;
+        bool equal;
+        uint64_t cache;
+    };
+
+    static void sample_sort_step(std::vector<StringItem>& arr, int low, int high, int depth, SortContext& ctx) {
+        std::vector<SplitBucket> buckets;
+        sample_split(arr, low, high, depth, ctx, buckets);
+        for (const SplitBucket& b : buckets) {
+            if (b.equal) {
+                recurse_equal(arr, b.low, b.high, depth, b.cache, ctx);
+            } else {
+                recurse(arr, b.low, b.high, depth, b.new_depth, ctx);
+            }
+        }
+    }
+
+    // Distributes arr[low..high] and appends its buckets of two or more items.
+    static void sample_split(std::vector<StringItem>& arr, int low, int high, int depth, SortContext& ctx,
+                             std::vector<SplitBucket>& out) {
+        ORASORT_PHASE(Partition);
+        const KeyAlphabet& alpha = ctx.alpha;
+        const int size = high - low + 1;
+        int levels = 1;
+        while (levels < kSampleLevels && (64 << levels) <= size) levels++;
+        const int splitters = (1 << levels) - 1;
+        const int buckets = 2 * splitters + 1;
+
+        // Equidistant caches of the sorted sample, duplicates dropped and the
+        // tail padded with the largest (its buckets stay empty).
+        std::vector<uint64_t> sample(kOversample * (splitters + 1));
+        for (auto& s : sample) s = arr[low + ctx.random(size)].cache;
+        std::sort(sample.begin(), sample.end());
+        uint64_t sorted[1 << kSampleLevels];
+        int unique = 0;
+        for (int i = 1; i <= splitters; ++i) {
+            const uint64_t s = sample[i * kOversample];
+            if (unique == 0 || s != sorted[unique - 1]) sorted[unique++] = s;
+        }
+        for (int i = unique; i <= splitters; ++i) sorted[i] = sorted[unique - 1];
+        uint64_t tree[1 << kSampleLevels];
+        build_splitter_tree(tree, sorted, 1, 0, splitters);
+
+        // Classification: the leaf reached is the number of splitters below the cache.
+        if (ctx.oracle.size() < static_cast<size_t>(size)) ctx.oracle.resize(size);
+        uint8_t* oracle = ctx.oracle.data();
+        StringItem* a = arr.data() + low;
+        int count[2 << kSampleLevels] = {0};
+        auto bucket_of = [&](uint64_t cache, int leaf) {
+            const int i = leaf - (splitters + 1);
+            return 2 * i + static_cast<int>((i < splitters) & (cache == sorted[i]));
+        };
+        int k = 0;
+        for (; k + 8 <= size; k += 8) {
+            int node[8];
+            for (int u = 0; u < 8; ++u) node[u] = 1;
+            for (int l = 0; l < levels; ++l) {
+                for (int u = 0; u < 8; ++u) node[u] = 2 * node[u] + static_cast<int>(a[k + u].cache > tree[node[u]]);
+            }
+            for (int u = 0; u < 8; ++u) {
+                const int b = bucket_of(a[k + u].cache, node[u]);
+                oracle[k + u] = static_cast<uint8_t>(b);
+                count[b]++;
+            }
+        }
+        for (; k < size; ++k) {
+            int node = 1;
+            for (int l = 0; l < levels; ++l) node = 2 * node + static_cast<int>(a[k].cache > tree[node]);
+            const int b = bucket_of(a[k].cache, node);
+            oracle[k] = static_cast<uint8_t>(b);
+            count[b]++;
+        }
+        ORASORT_COMPARE(static_cast<uint64_t>(size) * (levels + 1));
+
+        // Distribution: cycle leader, the oracle moving along with the items.
+        int next[2 << kSampleLevels], end[2 << kSampleLevels];
+        for (int b = 0, pos = 0; b < buckets; ++b) {
+            next[b] = pos;
+            pos += count[b];
+            end[b] = pos;
+        }
+        for (int b = 0; b < buckets; ++b) {
+            while (next[b] < end[b]) {
+                StringItem v = a[next[b]];
+                int vb = oracle[next[b]];
+                while (vb != b) {
+                    const int p = next[vb]++;
+                    std::swap(v, a[p]);
+                    const int displaced = oracle[p];
+                    oracle[p] = static_cast<uint8_t>(vb);
+                    vb = displaced;
+                }
+                a[next[b]++] = v;
+            }
+        }
+
+        for (int b = 0, pos = low; b < buckets; pos += count[b], ++b) {
+            if (count[b] < 2) continue;
+            const int lo = pos, hi = pos + count[b] - 1;
+            const int i = b / 2;
+            if (b % 2 == 0) {
+                int common = 0;
+                if (i > 0 && i < splitters && sorted[i - 1] != sorted[i]) {
+                    common = alpha.unpadded(sorted[i], __builtin_clzll(sorted[i - 1] ^ sorted[i]) / alpha.bits);
+                }
+                out.push_back(SplitBucket{lo, hi, depth + common, false, 0});
+            } else {
+                out.push_back(SplitBucket{lo, hi, depth, true, sorted[i]});
+            }
+        }
+    }
+
+    // Sorts arr[low..high], whose caches all equal cache at depth.
+    static void recurse_equal(std::vector<StringItem>& arr, int low, int high, int depth, uint64_t cache,
+                              SortContext& ctx) {
+        const KeyAlphabet& alpha = ctx.alpha;
+        if (!alpha.pads_spaces()) {
+            if (!alpha.ends_in(cache)) recurse(arr, low, high, depth, depth + alpha.symbols, ctx);
+        } else if (alpha.unpadded(cache, alpha.symbols) == alpha.symbols) {
+            recurse(arr, low, high, depth, depth + alpha.symbols, ctx);
+        } else {
+            // Spaces at the end of the window may be padding: no safe deeper depth.
+            std::sort(arr.begin() + low, arr.begin() + high + 1, [&](const StringItem& x, const StringItem& y) {
+                int match_len = 0;
+                return compare_padded(x, y, depth, match_len, alpha) < 0;
+            });
+        }
+    }
+
+    // Stores sorted[lo, hi) as the implicit tree below node (children 2n, 2n + 1).
+    static void build_splitter_tree(uint64_t* tree, const uint64_t* sorted, int node, int lo, int hi) {
+        if (lo >= hi) return;
+        const int mid = (lo + hi) / 2;
+        tree[node] = sorted[mid];
+        build_splitter_tree(tree, sorted, 2 * node, lo, mid);
+        build_splitter_tree(tree, sorted, 2 * node + 1, mid + 1, hi);
+    }
+
+    // --- Learned Distribution Step ---
+    // Smoothly distributed keys (timestamps, IDs, hash-like keys) are split
+    // by a model of their distribution instead of by comparisons. A sorted
+    // sample of caches trains a two-level piecewise-linear CDF: a root line
+    // picks a leaf, and each leaf interpolates between the first and last
+    // sample caches it received. Every item then costs a few multiply-adds,
+    // not a tree descent. The model is monotone in the cache, so the
+    // predicted buckets come out ordered and equal caches share a bucket.
+    // A bucket whose items share their cache word goes on a word deeper;
+    // the others start at the common prefix of their smallest and largest
+    // caches.
+    //
+    // Discrete or clustered caches crowd some buckets of the sample itself:
+    // the model is then dropped and the partition takes the comparison steps.
+    static constexpr int kLearnedSample = 4096;    // sample caches per step (at most)
+    static constexpr int kLearnedBuckets = 1024;   // buckets per step (at most)
+    static constexpr int kLearnedCrowding = 8;     // largest tolerated bucket, in mean bucket sizes
+
+    class CdfModel {
+    public:
+        // Trains on sorted caches; false if they do not spread over a range.
+        bool train(const std::vector<uint64_t>& sorted, int leaves, int buckets) {
+            const double lo = static_cast<double>(sorted.front());
+            const double hi = static_cast<double>(sorted.back());
+            if (!(hi > lo)) return false;
+            base_ = lo;
+            scale_ = leaves / (hi - lo);
+            buckets_ = buckets;
+            leaves_.assign(leaves, Leaf{});
+            const double per_sample = static_cast<double>(buckets) / sorted.size();
+            size_t first = 0;
+            for (int l = 0; l < leaves; ++l) {
+                size_t last = first;
+                while (last < sorted.size() && leaf_of(static_cast<double>(sorted[last])) == l) last++;
+                Leaf& leaf = leaves_[l];
+                leaf.r0 = first * per_sample;
+                leaf.r1 = last * per_sample;
+                if (last > first) {
+                    leaf.x0 = static_cast<double>(sorted[first]);
+                    const double span = static_cast<double>(sorted[last - 1]) - leaf.x0;
+                    if (span > 0) leaf.slope = (leaf.r1 - leaf.r0) / span;
+                }
+                first = last;
+            }
+            return true;
+        }
+
+        int bucket(uint64_t cache) const {
+            const double x = static_cast<double>(cache);
+            const Leaf& leaf = leaves_[leaf_of(x)];
+            const double r = std::min(std::max(leaf.r0 + (x - leaf.x0) * leaf.slope, leaf.r0), leaf.r1);
+            return std::min(static_cast<int>(r), buckets_ - 1);
+        }
+
+    private:
+        struct Leaf {
+            double x0 = 0, slope = 0;  // rank = r0 + (x - x0) * slope, clamped to [r0, r1]
+            double r0 = 0, r1 = 0;     // bucket ranks covered by the leaf
+        };
+        double base_ = 0, scale_ = 0;  // leaf = (x - base) * scale
+        int buckets_ = 1;
+        std::vector<Leaf> leaves_;
+
+        int leaf_of(double x) const {
+            const double l = (x - base_) * scale_;
+            const int last = static_cast<int>(leaves_.size()) - 1;
+            return l <= 0 ? 0 : l >= last ? last : static_cast<int>(l);
+        }
+    };
+
+    // Returns false, leaving arr untouched, when the model is rejected.
+    static bool learned_sort_step(std::vector<StringItem>& arr, int low, int high, int depth, SortContext& ctx) {
+        ORASORT_PHASE(Partition);
+        const KeyAlphabet& alpha = ctx.alpha;
+        const int size = high - low + 1;
+        const int samples = std::min(kLearnedSample, size / 4);
+        const int buckets = std::min(kLearnedBuckets, samples / 4);
+
+        std::vector<uint64_t> sample(samples);
+        for (auto& s : sample) s = arr[low + ctx.random(size)].cache;
+        std::sort(sample.begin(), sample.end());
+        CdfModel model;
+        if (!model.train(sample, std::max(1, samples / 32), buckets)) return false;
+        {
+            std::vector<int> hits(buckets, 0);
+            for (uint64_t s : sample) {
+                if (++hits[model.bucket(s)] > kLearnedCrowding * samples / buckets) return false;
+            }
+        }
+
+        // Classification, with the cache range of every bucket.
+        if (ctx.labels.size() < static_cast<size_t>(size)) ctx.labels.resize(size);
+        uint16_t* label = ctx.labels.data();
+        StringItem* a = arr.data() + low;
+        std::vector<int> count(buckets, 0), next(buckets), end(buckets);
+        std::vector<uint64_t> smallest(buckets, ~0ULL), largest(buckets, 0);
+        for (int k = 0; k < size; ++k) {
+            const uint64_t cache = a[k].cache;
+            const int b = model.bucket(cache);
+            label[k] = static_cast<uint16_t>(b);
+            count[b]++;
+            smallest[b] = std::min(smallest[b], cache);
+            largest[b] = std::max(largest[b], cache);
+        }
+
+        // Distribution: cycle leader, as in the sample sort step.
+        for (int b = 0, pos = 0; b < buckets; ++b) {
+            next[b] = pos;
+            pos += count[b];
+            end[b] = pos;
+        }
+        for (int b = 0; b < buckets; ++b) {
+            while (next[b] < end[b]) {
+                StringItem v = a[next[b]];
+                int vb = label[next[b]];
+                while (vb != b) {
+                    const int p = next[vb]++;
+                    std::swap(v, a[p]);
+                    const int displaced = label[p];
+                    label[p] = static_cast<uint16_t>(vb);
+                    vb = displaced;
+                }
+                a[next[b]++] = v;
+            }
+        }
+
+        for (int b = 0, pos = low; b < buckets; pos += count[b], ++b) {
+            if (count[b] < 2) continue;
+            const int lo = pos, hi = pos + count[b] - 1;
+            if (smallest[b] == largest[b]) {
+                recurse_equal(arr, lo, hi, depth, smallest[b], ctx);
+            } else {
+                const int common = __builtin_clzll(smallest[b] ^ largest[b]) / alpha.bits;
+                recurse(arr, lo, hi, depth, depth + alpha.unpadded(largest[b], common), ctx);
+            }
+        }
+        return true;
+    }
+
+    // --- Vectorized Three-Way Partition ---
+    // Caches are compared against the broadcast pivot cache 4 (AVX2) or 8
+    // (AVX-512) at a time. Items below the pivot are written back in place
+    // (the write cursor never passes the read cursor), items above go to the
+    // scratch buffer from the front, and keys identical to the pivot go to its
+    // back: they are finished and never recursed into.
+    //
+    // The shared prefix of each side needs no per-lane lzcnt: the smallest clz
+    // of several XORs is the clz of their OR, so the kernels OR the XORs per
+    // side and we count once at the end. Cache ties take the scalar slow path.
+    struct PartitionState {
+        StringItem* left;   // next slot for an item below the pivot (inside arr)
+        StringItem* right;  // next slot for an item above the pivot (scratch, upwards)
+        StringItem* equal;  // last slot taken by a key identical to the pivot (scratch, downwards)
+        uint64_t xor_left;  // OR of cache XORs of the items below the pivot
+        uint64_t xor_right;
+        int tie_left;       // smallest match length among cache ties below the pivot
+        int tie_right;
+    };
+
+    static void partition_three_way(std::vector<StringItem>& arr, int low, int high, int depth,
+                                    const StringItem& pivot, SortContext& ctx) {
+        const KeyAlphabet& alpha = ctx.alpha;
+        const int size = high - low + 1;
+        if (ctx.scratch.size() < static_cast<size_t>(size)) ctx.scratch.resize(size);
+        StringItem* base = arr.data() + low;
+        StringItem* scratch = ctx.scratch.data();
+
+        PartitionState st;
+        st.left = base;
+        st.right = scratch;
+        st.equal = scratch + size;
+        st.xor_left = st.xor_right = 0;
+        st.tie_left = st.tie_right = INT_MAX;
+
+        const StringItem* p = base + 1;
+        const StringItem* end = base + size;
+#if ORASORT_X86_SIMD
+        if (ctx.kernel == PartitionKernel::AVX512) p = classify_avx512(p, end, pivot, depth, st, alpha);
+        if (ctx.kernel == PartitionKernel::AVX2) p = classify_avx2(p, end, pivot, depth, st, alpha);
+#endif
+        classify_scalar(p, end, pivot, depth, st, alpha);
+
+        // Layout: below | pivot, identical keys | above
+        const int n_left = static_cast<int>(st.left - base);
+        const int n_right = static_cast<int>(st.right - scratch);
+        StringItem* out = st.left;
+        *out++ = pivot;
+        out = std::copy(st.equal, scratch + size, out);
+        std::copy(scratch, st.right, out);
+
+        // An empty side has no match length: use 0 so that depth + common cannot overflow.
+        // Every item shares the cached symbols it matched with the pivot, so the
+        // pivot's cache tells where padding may start.
+        int common_left = n_left ? st.tie_left : 0;
+        if (st.xor_left) {
+            common_left = std::min(common_left, alpha.unpadded(pivot.cache, __builtin_clzll(st.xor_left) / alpha.bits));
+        }
+        int common_right = n_right ? st.tie_right : 0;
+        if (st.xor_right) {
+            common_right =
+                std::min(common_right, alpha.unpadded(pivot.cache, __builtin_clzll(st.xor_right) / alpha.bits));
+        }
+
+        recurse(arr, low, low + n_left - 1, depth, depth + common_left, ctx);
+        recurse(arr, high - n_right + 1, high, depth, depth + common_right, ctx);
+    }
+
+    // Cache tie with the pivot: compare beyond the cache.
+    static void classify_tie(const StringItem& item, const StringItem& pivot, int depth, PartitionState& st,
+                             const KeyAlphabet& alpha) {
+        int match_len = 0;
+        int cmp = compare_and_count(item, pivot, depth, match_len, alpha);
+        if (cmp < 0) {
+            *st.left++ = item;
+            st.tie_left = std::min(st.tie_left, match_len);
+        } else if (cmp > 0) {
+            *st.right++ = item;
+            st.tie_right = std::min(st.tie_right, match_len);
+        } else {
+            *--st.equal = item;
+        }
+    }
+
+    static void classify_scalar(const StringItem* p, const StringItem* end, const StringItem& pivot, int depth,
+                                PartitionState& st, const KeyAlphabet& alpha) {
+        for (; p != end; ++p) {
+            const StringItem item = *p;
+            if (item.cache < pivot.cache) {
+                ORASORT_COMPARE(1);
+                st.xor_left |= item.cache ^ pivot.cache;
+                *st.left++ = item;
+            } else if (item.cache > pivot.cache) {
+                ORASORT_COMPARE(1);
+                st.xor_right |= item.cache ^ pivot.cache;
+                *st.right++ = item;
+            } else {
+                classify_tie(item, pivot, depth, st, alpha);
+            }
+        }
+    }
+
+#if ORASORT_X86_SIMD
+    // AVX2 has neither unsigned 64-bit compares nor compress-store: flip the
+    // sign bits for a signed compare, and store every item to both sides,
+    // advancing only the cursor of the side it belongs to.
+    __attribute__((target("avx2")))
+    static const StringItem* classify_avx2(const StringItem* p, const StringItem* end, const StringItem& pivot,
+                                           int depth, PartitionState& st, const KeyAlphabet& alpha) {
+        const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+        const __m256i cache_lanes = _mm256_set_epi64x(-1, 0, -1, 0);
+        const __m256i pv = _mm256_set1_epi64x(static_cast<long long>(pivot.cache));
+        const __m256i pv_signed = _mm256_xor_si256(pv, sign);
+        __m256i acc_left = _mm256_setzero_si256();
+        __m256i acc_right = _mm256_setzero_si256();
+
+        for (; end - p >= 4; p += 4) {
+            const __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            const __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 2));
+            const __m256i s0 = _mm256_xor_si256(v0, sign);
+            const __m256i s1 = _mm256_xor_si256(v1, sign);
+            const __m256i lt0 = _mm256_and_si256(_mm256_cmpgt_epi64(pv_signed, s0), cache_lanes);
+            const __m256i lt1 = _mm256_and_si256(_mm256_cmpgt_epi64(pv_signed, s1), cache_lanes);
+            const __m256i gt0 = _mm256_and_si256(_mm256_cmpgt_epi64(s0, pv_signed), cache_lanes);
+            const __m256i gt1 = _mm256_and_si256(_mm256_cmpgt_epi64(s1, pv_signed), cache_lanes);
+
+            acc_left = _mm256_or_si256(acc_left, _mm256_and_si256(lt0, _mm256_xor_si256(v0, pv)));
+            acc_left = _mm256_or_si256(acc_left, _mm256_and_si256(lt1, _mm256_xor_si256(v1, pv)));
+            acc_right = _mm256_or_si256(acc_right, _mm256_and_si256(gt0, _mm256_xor_si256(v0, pv)));
+            acc_right = _mm256_or_si256(acc_right, _mm256_and_si256(gt1, _mm256_xor_si256(v1, pv)));
+
+            // Bits 1, 3, 5, 7: cache lanes of items 0..3
+            const int lt = _mm256_movemask_pd(_mm256_castsi256_pd(lt0)) |
+                           (_mm256_movemask_pd(_mm256_castsi256_pd(lt1)) << 4);
+            const int gt = _mm256_movemask_pd(_mm256_castsi256_pd(gt0)) |
+                           (_mm256_movemask_pd(_mm256_castsi256_pd(gt1)) << 4);
+            ORASORT_COMPARE(__builtin_popcount(lt | gt));  // ties count in compare_and_count
+
+            for (int k = 0; k < 4; ++k) {
+                const StringItem item = p[k];
+                const int is_left = (lt >> (2 * k + 1)) & 1;
+                const int is_right = (gt >> (2 * k + 1)) & 1;
+                *st.left = item;
+                *st.right = item;
+                st.left += is_left;
+                st.right += is_right;
+                if (!(is_left | is_right)) classify_tie(item, pivot, depth, st, alpha);
+            }
+        }
+
+        uint64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc_left);
+        st.xor_left |= lanes[1] | lanes[3];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc_right);
+        st.xor_right |= lanes[1] | lanes[3];
+        return p;
+    }
+
+    // --- Sorting Network for Small Partitions ---
+    // The caches of a small partition are sorted by a bitonic network while
+    // the item indices ride along in a parallel array, moved by the same blend
+    // masks: no data-dependent branches. Runs of equal caches are then fixed
+    // up by sorting them one cache word deeper (unless they are identical keys).
+    __attribute__((target("avx2")))
+    static void sort_small_network(std::vector<StringItem>& arr, int low, int high, int depth, SortContext& ctx) {
+        ORASORT_PHASE(SmallSort);
+        const int size = high - low + 1;
+        int n = 4;
+        while (n < size) n <<= 1;
+
+        // Padding sorts last; its indices are skipped when items are gathered.
+        alignas(32) uint64_t keys[kNetworkMax];
+        alignas(32) uint64_t index[kNetworkMax];
+        for (int t = 0; t < n; ++t) {
+            keys[t] = (t < size) ? arr[low + t].cache : UINT64_MAX;
+            index[t] = static_cast<uint64_t>(t);
+        }
+        bitonic_sort_avx2(keys, index, n);
+
+        if (ctx.scratch.size() < static_cast<size_t>(size)) ctx.scratch.resize(size);
+        StringItem* saved = ctx.scratch.data();
+        std::copy(arr.begin() + low, arr.begin() + high + 1, saved);
+        int out = low;
+        for (int t = 0; t < n; ++t) {
+            if (index[t] < static_cast<uint64_t>(size)) arr[out++] = saved[index[t]];
+        }
+
+        // Tie fixup: equal caches that do not end inside the window share all
+        // cached symbols, so the run continues at depth + symbols. Under space
+        // padding a cache ending in spaces may or may not end its keys: such
+        // runs are sorted by full comparisons.
+        const KeyAlphabet& alpha = ctx.alpha;
+        for (int a = low; a <= high;) {
+            int b = a;
+            while (b < high && arr[b + 1].cache == arr[a].cache) ++b;
+            if (b > a) {
+                if (!alpha.pads_spaces()) {
+                    if (!alpha.ends_in(arr[a].cache)) recurse(arr, a, b, depth, depth + alpha.symbols, ctx);
+                } else if (alpha.unpadded(arr[a].cache, alpha.symbols) == alpha.symbols) {
+                    recurse(arr, a, b, depth, depth + alpha.symbols, ctx);
+                } else {
+                    std::sort(arr.begin() + a, arr.begin() + b + 1, [&](const StringItem& x, const StringItem& y) {
+                        int match_len = 0;
+                        return compare_padded(x, y, depth, match_len, alpha) < 0;
+                    });
+                }
+            }
+            a = b + 1;
+        }
+    }
+
+    // Bitonic sort of n (power of two, >= 4) unsigned keys with their indices.
+    // Compare-exchange distances of 4 and more pair whole registers; distances
+    // 2 and 1 pair lanes inside a register through a permute.
+    __attribute__((target("avx2")))
+    static void bitonic_sort_avx2(uint64_t* keys, uint64_t* index, int n) {
+        const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+        for (int k = 2; k <= n; k <<= 1) {
+            for (int j = k >> 1; j > 0; j >>= 1) {
+                for (int i = 0; i < n; i += 4) {
+                    __m256i* kp = reinterpret_cast<__m256i*>(keys + i);
+                    __m256i* ip = reinterpret_cast<__m256i*>(index + i);
+                    if (j >= 4) {
+                        if (i & j) continue;
+                        ORASORT_COMPARE(4);
+                        __m256i* kq = reinterpret_cast<__m256i*>(keys + i + j);
+                        __m256i* iq = reinterpret_cast<__m256i*>(index + i + j);
+                        const __m256i a = _mm256_load_si256(kp), b = _mm256_load_si256(kq);
+                        const __m256i ia = _mm256_load_si256(ip), ib = _mm256_load_si256(iq);
+                        const __m256i a_lt_b = _mm256_cmpgt_epi64(_mm256_xor_si256(b, sign), _mm256_xor_si256(a, sign));
+                        const __m256i lo = _mm256_blendv_epi8(b, a, a_lt_b), hi = _mm256_blendv_epi8(a, b, a_lt_b);
+                        const __m256i ilo = _mm256_blendv_epi8(ib, ia, a_lt_b), ihi = _mm256_blendv_epi8(ia, ib, a_lt_b);
+                        const bool ascending = (i & k) == 0;
+                        _mm256_store_si256(kp, ascending ? lo : hi);
+                        _mm256_store_si256(kq, ascending ? hi : lo);
+                        _mm256_store_si256(ip, ascending ? ilo : ihi);
+                        _mm256_store_si256(iq, ascending ? ihi : ilo);
+                    } else {
+                        ORASORT_COMPARE(2);
+                        const __m256i a = _mm256_load_si256(kp), ia = _mm256_load_si256(ip);
+                        const __m256i b = (j == 2) ? _mm256_permute4x64_epi64(a, 0x4E) : _mm256_permute4x64_epi64(a, 0xB1);
+                        const __m256i ib = (j == 2) ? _mm256_permute4x64_epi64(ia, 0x4E) : _mm256_permute4x64_epi64(ia, 0xB1);
+                        // A lane keeps the smaller key when it is the lower lane of an
+                        // ascending pair or the upper lane of a descending one.
+                        long long take_min[4];
+                        for (int l = 0; l < 4; ++l) {
+                            take_min[l] = ((((i + l) & j) == 0) == (((i + l) & k) == 0)) ? -1 : 0;
+                        }
+                        const __m256i want_min = _mm256_set_epi64x(take_min[3], take_min[2], take_min[1], take_min[0]);
+                        const __m256i a_lt_b = _mm256_cmpgt_epi64(_mm256_xor_si256(b, sign), _mm256_xor_si256(a, sign));
+                        const __m256i a_gt_b = _mm256_cmpgt_epi64(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+                        const __m256i keep = _mm256_blendv_epi8(a_gt_b, a_lt_b, want_min);
+                        _mm256_store_si256(kp, _mm256_blendv_epi8(b, a, keep));
+                        _mm256_store_si256(ip, _mm256_blendv_epi8(ib, ia, keep));
+                    }
+                }
+            }
+        }
+    }
+
+    // AVX-512: unsigned compares on the odd (cache) lanes, then each side is
+    // written with one compress-store of the item pairs per register.
+    __attribute__((target("avx512f")))
+    static const StringItem* classify_avx512(const StringItem* p, const StringItem* end, const StringItem& pivot,
+                                             int depth, PartitionState& st, const KeyAlphabet& alpha) {
+        const __mmask8 cache_lanes = 0xAA;
+        const __m512i pv = _mm512_set1_epi64(static_cast<long long>(pivot.cache));
+        __m512i acc_left = _mm512_setzero_si512();
+        __m512i acc_right = _mm512_setzero_si512();
+
+        for (; end - p >= 8; p += 8) {
+            const __m512i v[2] = {_mm512_loadu_si512(p), _mm512_loadu_si512(p + 4)};
+            __mmask8 lt[2], gt[2];
+            int ties = 0;
+            for (int r = 0; r < 2; ++r) {
+                lt[r] = _mm512_mask_cmplt_epu64_mask(cache_lanes, v[r], pv);
+                gt[r] = _mm512_mask_cmpgt_epu64_mask(cache_lanes, v[r], pv);
+                const __m512i diff = _mm512_xor_si512(v[r], pv);
+                acc_left = _mm512_mask_or_epi64(acc_left, lt[r], acc_left, diff);
+                acc_right = _mm512_mask_or_epi64(acc_right, gt[r], acc_right, diff);
+                ties |= (cache_lanes & ~(lt[r] | gt[r])) << (8 * r);
+                ORASORT_COMPARE(__builtin_popcount(lt[r] | gt[r]));
+            }
+
+            // Keep a copy of tied items: the compress-stores below may overwrite them in arr.
+            alignas(64) StringItem block[8];
+            if (ties) {
+                _mm512_store_si512(block, v[0]);
+                _mm512_store_si512(block + 4, v[1]);
+            }
+
+            for (int r = 0; r < 2; ++r) {
+                _mm512_mask_compressstoreu_epi64(st.left, static_cast<__mmask8>(lt[r] | (lt[r] >> 1)), v[r]);
+                st.left += __builtin_popcount(lt[r]);
+                _mm512_mask_compressstoreu_epi64(st.right, static_cast<__mmask8>(gt[r] | (gt[r] >> 1)), v[r]);
+                st.right += __builtin_popcount(gt[r]);
+            }
+
+            while (ties) {
+                const int lane = __builtin_ctz(ties);
+                classify_tie(block[lane / 2], pivot, depth, st, alpha);
+                ties &= ties - 1;
+            }
+        }
+
+        alignas(64) uint64_t lanes[8];
+        _mm512_store_si512(lanes, acc_left);
+        st.xor_left |= lanes[1] | lanes[3] | lanes[5] | lanes[7];
+        _mm512_store_si512(lanes, acc_right);
+        st.xor_right |= lanes[1] | lanes[3] | lanes[5] | lanes[7];
+        return p;
+    }
+#endif
+};
@@ -0,0 +1,480 @@
+// Benchmark of the sort engines on synthetic key sets.
+//
+//   g++ -O2 -std=c++17 -pthread orasort_bench.cpp -o orasort_bench
+//   g++ -O2 -std=c++17 -pthread -DORASORT_BYTE_STATS orasort_bench.cpp -o orasort_bench_bytes
+//
+// The C engines join in when linked as libraries:
+//
+//   gcc -O2 -c -DORASORT_LIBRARY orasort.c orasort2.c
+//   g++ -O2 -std=c++17 -pthread -DORASORT_WITH_C orasort_bench.cpp orasort.o orasort2.o -o orasort_bench
+//
+//   ./orasort_bench [options] [keys] [dataset | file...]
+//
+//   --trials N        runs per engine and dataset (default 1); times are medians
+//   --save FILE       stores the results as a JSON baseline
+//   --check FILE      compares against a baseline, exit status 1 on regressions
+//   --threshold PCT   tolerated slowdown before a result counts (default 10)
+//   --scaling         thread scaling study of the parallel sort instead
+//   --threads N       largest thread count of the study (default: all cores)
+//
+// Each argument names a DatasetGenerator corpus, generated with the given
+// number of keys, or a file with one key per line (see orasort_gen.cpp).
+// Reports time per key for std::sort, LegrandSort, OptimizedOrasort and
+// LcpMergeSort. The ORASORT_BYTE_STATS build also reports the comparisons and
+// key bytes each engine read and divides the bytes by the distinguishing
+// prefix size D of the input: the sum over all keys of the bytes needed to
+// tell a key apart from every other key. D is a lower bound for any string
+// sort, so bytes / D shows how much of the common-prefix-skipping promise an
+// engine keeps on a given data shape. The C engines are not instrumented.
+//
+// The scaling study sorts each dataset at 1, 2, 4, ... threads and reports
+// speedup, parallel efficiency and the memory bandwidth the sort achieves,
+// next to a STREAM-style copy/triad measured at the same thread count. A sort
+// running close to triad bandwidth is bandwidth-bound on that host; one far
+// below it is compute-bound (or latency-bound on its key loads).
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "orasort.hpp"
+#include "orasort2.hpp"
+#include "orasort_datasets.hpp"
+#include "orasort_merge.hpp"
+
+#ifdef ORASORT_WITH_C
+extern "C" void legrand_sort(char** arr, int n);
+#include "orasort2.h"
+#endif
+
+namespace {
+
+template <typename F>
+double time_ms(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// --- Distinguishing Prefix ---
+
+#ifdef ORASORT_BYTE_STATS
+size_t lcp(const std::string& a, const std::string& b) {
+    size_t k = 0;
+    while (k < a.size() && k < b.size() && a[k] == b[k]) k++;
+    return k;
+}
+
+// Sum over keys of min(len, longest lcp with a neighbour in sorted order + 1).
+uint64_t distinguishing_prefix(std::vector<std::string> keys) {
+    std::sort(keys.begin(), keys.end());
+    uint64_t d = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        size_t l = 0;
+        if (i > 0) l = std::max(l, lcp(keys[i - 1], keys[i]));
+        if (i + 1 < keys.size()) l = std::max(l, lcp(keys[i], keys[i + 1]));
+        d += std::min(keys[i].size(), l + 1);
+    }
+    return d;
+}
+#endif
+
+// --- Engines ---
+
+struct Engine {
+    const char* name;
+    bool instrumented;
+    std::function<double(std::vector<std::string>&)> sort;  // returns the sort time in ms
+};
+
+#ifdef ORASORT_WITH_C
+// Sorts pointers to the keys with a C engine, then rebuilds the vector in
+// that order. Only the C sort itself is timed.
+double sort_with_c(std::vector<std::string>& v, void (*sort)(char**, int)) {
+    std::vector<char*> ptrs(v.size());
+    for (size_t i = 0; i < v.size(); ++i) ptrs[i] = const_cast<char*>(v[i].c_str());
+    double ms = time_ms([&] { sort(ptrs.data(), static_cast<int>(ptrs.size())); });
+    std::vector<std::string> sorted(ptrs.begin(), ptrs.end());
+    v.swap(sorted);
+    return ms;
+}
+#endif
+
+std::vector<Engine> engines() {
+    return {
+        {"std::sort", true, [](std::vector<std::string>& v) {
+             return time_ms([&] {
+                 std::sort(v.begin(), v.end(), [](const std::string& a, const std::string& b) {
+#ifdef ORASORT_BYTE_STATS
+                     ORASORT_COMPARE(1);
+                     ORASORT_INSPECT(2 * std::min(lcp(a, b) + 1, std::max(a.size(), b.size())));
+#endif
+                     return a < b;
+                 });
+             });
+         }},
+        {"LegrandSort", true, [](std::vector<std::string>& v) { return time_ms([&] { LegrandSort::sort(v); }); }},
+        {"OptimizedOrasort", true,
+         [](std::vector<std::string>& v) { return time_ms([&] { OptimizedOrasort::sort(v); }); }},
+        {"OptimizedOrasort/par", true,
+         [](std::vector<std::string>& v) { return time_ms([&] { OptimizedOrasort::sort_parallel(v); }); }},
+        {"LcpMergeSort/par", true,
+         [](std::vector<std::string>& v) { return time_ms([&] { LcpMergeSort::sort_parallel(v); }); }},
+#ifdef ORASORT_WITH_C
+        {"legrand_sort (C)", false, [](std::vector<std::string>& v) { return sort_with_c(v, legrand_sort); }},
+        {"optimized_orasort (C)", false,
+         [](std::vector<std::string>& v) { return sort_with_c(v, optimized_orasort); }},
+        {"american_flag_sort (C)", false,
+         [](std::vector<std::string>& v) { return sort_with_c(v, american_flag_sort); }},
+#endif
+    };
+}
+
+// --- Results and Baselines ---
+
+struct Result {
+    std::string dataset;
+    std::string engine;
+    double ns_per_key = 0;       // median over the trials
+    double mad = 0;              // median absolute deviation of ns_per_key
+    long long comparisons = -1;  // -1: not counted
+    long long bytes = -1;
+};
+
+double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    size_t m = v.size() / 2;
+    return (v.size() % 2) ? v[m] : (v[m - 1] + v[m]) / 2;
+}
+
+std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+bool save_baseline(const std::string& path, size_t keys, int trials, const std::vector<Result>& results) {
+    std::ofstream out(path);
+    if (!out) return false;
+    char line[512];
+    out << "{\"keys\": " << keys << ", \"trials\": " << trials << ", \"results\": [\n";
+    for (size_t r = 0; r < results.size(); ++r) {
+        const Result& res = results[r];
+        std::snprintf(line, sizeof(line),
+                      "  {\"dataset\": \"%s\", \"engine\": \"%s\", \"ns_per_key\": %.3f, \"mad\": %.3f, "
+                      "\"comparisons\": %lld, \"bytes\": %lld}%s\n",
+                      json_escape(res.dataset).c_str(), json_escape(res.engine).c_str(), res.ns_per_key, res.mad,
+                      res.comparisons, res.bytes, r + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "]}\n";
+    return static_cast<bool>(out);
+}
+
+// Value of "key" in a flat JSON object as written by save_baseline: the
+// unescaped string, or the raw number text.
+std::string json_field(const std::string& object, const std::string& key) {
+    size_t p = object.find("\"" + key + "\"");
+    if (p == std::string::npos) return "";
+    p = object.find(':', p);
+    if (p == std::string::npos) return "";
+    p = object.find_first_not_of(" \t\n", p + 1);
+    if (p == std::string::npos) return "";
+    std::string value;
+    if (object[p] == '"') {
+        for (++p; p < object.size() && object[p] != '"'; ++p) {
+            if (object[p] == '\\' && p + 1 < object.size()) ++p;
+            value += object[p];
+        }
+    } else {
+        size_t end = object.find_first_of(",}", p);
+        value = object.substr(p, end - p);
+    }
+    return value;
+}
+
+bool load_baseline(const std::string& path, size_t& keys, std::vector<Result>& results) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    const std::string text = buffer.str();
+    size_t list = text.find("\"results\"");
+    if (list == std::string::npos) return false;
+    keys = std::strtoull(json_field(text.substr(0, list), "keys").c_str(), nullptr, 10);
+    for (size_t p = text.find('{', list); p != std::string::npos; p = text.find('{', p + 1)) {
+        size_t end = text.find('}', p);
+        if (end == std::string::npos) return false;
+        const std::string object = text.substr(p, end - p + 1);
+        Result r;
+        r.dataset = json_field(object, "dataset");
+        r.engine = json_field(object, "engine");
+        r.ns_per_key = std::strtod(json_field(object, "ns_per_key").c_str(), nullptr);
+        r.mad = std::strtod(json_field(object, "mad").c_str(), nullptr);
+        r.comparisons = std::strtoll(json_field(object, "comparisons").c_str(), nullptr, 10);
+        r.bytes = std::strtoll(json_field(object, "bytes").c_str(), nullptr, 10);
+        results.push_back(r);
+        p = end;
+    }
+    return true;
+}
+
+// A slowdown counts when it exceeds the threshold and three times the
+// larger trial-to-trial deviation of the two runs; counters, which barely
+// vary, only need to exceed the threshold.
+int check_baseline(const std::vector<Result>& current, const std::vector<Result>& baseline, double threshold) {
+    int regressions = 0;
+    std::printf("\n%-16s %-22s %12s %12s %8s  %s\n", "dataset", "engine", "base ns/key", "ns/key", "change",
+                "status");
+    for (const Result& cur : current) {
+        auto base = std::find_if(baseline.begin(), baseline.end(), [&](const Result& b) {
+            return b.dataset == cur.dataset && b.engine == cur.engine;
+        });
+        if (base == baseline.end()) {
+            std::printf("%-16s %-22s %12s %12.1f %8s  new\n", cur.dataset.c_str(), cur.engine.c_str(), "-",
+                        cur.ns_per_key, "-");
+            continue;
+        }
+        std::string status;
+        const double noise = 3 * std::max(base->mad, cur.mad);
+        if (cur.ns_per_key > base->ns_per_key * (1 + threshold) && cur.ns_per_key - base->ns_per_key > noise) {
+            status += " time";
+        }
+        if (cur.comparisons >= 0 && base->comparisons >= 0 &&
+            cur.comparisons > base->comparisons * (1 + threshold)) {
+            status += " comparisons";
+        }
+        if (cur.bytes >= 0 && base->bytes >= 0 && cur.bytes > base->bytes * (1 + threshold)) status += " bytes";
+        if (!status.empty()) regressions++;
+        std::printf("%-16s %-22s %12.1f %12.1f %+7.1f%%  %s\n", cur.dataset.c_str(), cur.engine.c_str(),
+                    base->ns_per_key, cur.ns_per_key, 100.0 * (cur.ns_per_key / base->ns_per_key - 1),
+                    status.empty() ? "ok" : ("REGRESSION:" + status).c_str());
+    }
+    return regressions;
+}
+
+// --- Thread Scaling ---
+
+struct StreamResult {
+    double copy_gbs;
+    double triad_gbs;
+};
+
+// STREAM-style copy (c = a) and triad (a = b + s * c) over arrays far larger
+// than any cache, each thread working on its own slice. Best of five runs;
+// bytes are counted the way STREAM does (16 and 24 per element).
+StreamResult stream_bandwidth(unsigned threads, size_t elements = size_t(1) << 23) {
+    std::vector<double> a(elements), b(elements), c(elements);
+    auto parallel = [&](auto&& kernel) {
+        std::vector<std::thread> pool;
+        for (unsigned t = 0; t < threads; ++t) {
+            pool.emplace_back([&, t] { kernel(elements * t / threads, elements * (t + 1) / threads); });
+        }
+        for (auto& th : pool) th.join();
+    };
+    // First touch from the worker threads places pages near them.
+    parallel([&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) a[i] = 1.0, b[i] = 2.0, c[i] = 0.0;
+    });
+
+    StreamResult best = {0, 0};
+    for (int run = 0; run < 5; ++run) {
+        double ms = time_ms([&] {
+            parallel([&](size_t lo, size_t hi) {
+                for (size_t i = lo; i < hi; ++i) c[i] = a[i];
+            });
+        });
+        best.copy_gbs = std::max(best.copy_gbs, 16.0 * elements / (ms * 1e6));
+        ms = time_ms([&] {
+            parallel([&](size_t lo, size_t hi) {
+                for (size_t i = lo; i < hi; ++i) a[i] = b[i] + 3.0 * c[i];
+            });
+        });
+        best.triad_gbs = std::max(best.triad_gbs, 24.0 * elements / (ms * 1e6));
+    }
+    return best;
+}
+
+// Memory traffic of a sort, modelled from its work counters: a partition
+// reads and writes each item; a cache refresh reads and writes the item and
+// loads the key at a random address, one cache line.
+double sort_traffic_bytes(const OptimizedOrasort::SortStats& stats) {
+    return stats.partitioned * 2.0 * sizeof(StringItem) + stats.refreshed * (2.0 * sizeof(StringItem) + 64);
+}
+
+int run_scaling(const std::vector<std::string>& datasets, size_t n, int trials, unsigned max_threads) {
+    std::vector<unsigned> counts;
+    for (unsigned t = 1; t < max_threads; t *= 2) counts.push_back(t);
+    counts.push_back(max_threads);
+
+    std::vector<StreamResult> stream;
+    std::printf("%-8s %12s %12s\n", "threads", "copy GB/s", "triad GB/s");
+    for (unsigned t : counts) {
+        stream.push_back(stream_bandwidth(t));
+        std::printf("%-8u %12.2f %12.2f\n", t, stream.back().copy_gbs, stream.back().triad_gbs);
+    }
+
+    for (const auto& name : datasets) {
+        std::vector<std::string> input = DatasetGenerator::generate(name, n);
+        if (input.empty() && !DatasetGenerator::read_keys(name, input)) {
+            std::fprintf(stderr, "neither a dataset nor a readable file: %s\n", name.c_str());
+            return 1;
+        }
+        std::printf("\n%-16s %8s %10s %8s %8s %10s %8s\n", name.c_str(), "threads", "ms", "speedup", "effic.",
+                    "GB/s", "% triad");
+        double serial_ms = 0;
+        for (size_t c = 0; c < counts.size(); ++c) {
+            std::vector<double> times(trials);
+            OptimizedOrasort::SortStats stats;
+            for (int t = 0; t < trials; ++t) {
+                std::vector<StringItem> items(input.size());
+                for (size_t i = 0; i < input.size(); ++i) items[i].ptr = input[i].c_str();
+                times[t] = time_ms([&] { OptimizedOrasort::sort_items_parallel(items, counts[c], &stats); });
+            }
+            const double ms = median(times);
+            if (c == 0) serial_ms = ms;
+            const double gbs = sort_traffic_bytes(stats) / (ms * 1e6);
+            std::printf("%-16s %8u %10.2f %8.2f %7.0f%% %10.2f %7.0f%%\n", "", counts[c], ms, serial_ms / ms,
+                        100.0 * serial_ms / ms / counts[c], gbs, 100.0 * gbs / stream[c].triad_gbs);
+        }
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t n = 200000;
+    int trials = 1;
+    double threshold = 0.10;
+    std::string save_path, check_path;
+    bool scaling = false;
+    unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> datasets;
+    for (int a = 1; a < argc; ++a) {
+        const std::string arg = argv[a];
+        if (arg == "--trials" && a + 1 < argc) {
+            trials = std::max(1, std::atoi(argv[++a]));
+        } else if (arg == "--save" && a + 1 < argc) {
+            save_path = argv[++a];
+        } else if (arg == "--check" && a + 1 < argc) {
+            check_path = argv[++a];
+        } else if (arg == "--threshold" && a + 1 < argc) {
+            threshold = std::atof(argv[++a]) / 100;
+        } else if (arg == "--scaling") {
+            scaling = true;
+        } else if (arg == "--threads" && a + 1 < argc) {
+            max_threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++a])));
+        } else if (std::isdigit(static_cast<unsigned char>(arg[0]))) {
+            n = std::strtoull(arg.c_str(), nullptr, 10);
+        } else {
+            datasets.push_back(arg);
+        }
+    }
+    if (datasets.empty()) datasets = DatasetGenerator::names();
+    if (scaling) return run_scaling(datasets, n, trials, max_threads);
+
+    std::vector<Result> baseline;
+    if (!check_path.empty()) {
+        size_t baseline_keys = 0;
+        if (!load_baseline(check_path, baseline_keys, baseline)) {
+            std::fprintf(stderr, "cannot read baseline %s\n", check_path.c_str());
+            return 1;
+        }
+        if (baseline_keys != n) {
+            std::fprintf(stderr, "baseline %s was recorded with %zu keys, not %zu\n", check_path.c_str(),
+                         baseline_keys, n);
+            return 1;
+        }
+    }
+
+#ifdef ORASORT_BYTE_STATS
+    std::printf("%-16s %-22s %10s %10s %8s %12s %14s %12s %8s\n", "dataset", "engine", "ms", "ns/key", "+-",
+                "comparisons", "bytes read", "D", "bytes/D");
+#else
+    std::printf("%-16s %-22s %10s %10s %8s\n", "dataset", "engine", "ms", "ns/key", "+-");
+#endif
+
+    std::vector<Result> results;
+    for (const auto& name : datasets) {
+        std::vector<std::string> input = DatasetGenerator::generate(name, n);
+        if (input.empty() && !DatasetGenerator::read_keys(name, input)) {
+            std::fprintf(stderr, "neither a dataset nor a readable file: %s\n", name.c_str());
+            return 1;
+        }
+        std::vector<std::string> expected = input;
+        std::sort(expected.begin(), expected.end());
+#ifdef ORASORT_BYTE_STATS
+        const uint64_t d = distinguishing_prefix(input);
+#endif
+
+        for (const auto& engine : engines()) {
+            Result res;
+            res.dataset = name;
+            res.engine = engine.name;
+            std::vector<double> ns(trials);
+            for (int t = 0; t < trials; ++t) {
+                std::vector<std::string> keys = input;
+                ByteInspection::reset();
+                double ms = engine.sort(keys);
+                ns[t] = input.empty() ? 0.0 : ms * 1e6 / input.size();
+                if (keys != expected) {
+                    std::fprintf(stderr, "%s produced a wrong order on %s\n", engine.name, name.c_str());
+                    return 1;
+                }
+#ifdef ORASORT_BYTE_STATS
+                if (engine.instrumented) {
+                    res.comparisons = static_cast<long long>(ByteInspection::comparisons());
+                    res.bytes = static_cast<long long>(ByteInspection::bytes());
+                }
+#endif
+            }
+            res.ns_per_key = median(ns);
+            std::vector<double> deviation(trials);
+            for (int t = 0; t < trials; ++t) deviation[t] = std::fabs(ns[t] - res.ns_per_key);
+            res.mad = median(deviation);
+            results.push_back(res);
+
+            const double ms = res.ns_per_key * input.size() / 1e6;
+#ifdef ORASORT_BYTE_STATS
+            if (res.bytes >= 0) {
+                std::printf("%-16s %-22s %10.2f %10.1f %8.1f %12lld %14lld %12llu %8.2f\n", name.c_str(),
+                            engine.name, ms, res.ns_per_key, res.mad, res.comparisons, res.bytes,
+                            static_cast<unsigned long long>(d), d ? static_cast<double>(res.bytes) / d : 0.0);
+            } else {
+                std::printf("%-16s %-22s %10.2f %10.1f %8.1f %12s %14s %12llu %8s\n", name.c_str(), engine.name,
+                            ms, res.ns_per_key, res.mad, "-", "-", static_cast<unsigned long long>(d), "-");
+            }
+#else
+            std::printf("%-16s %-22s %10.2f %10.1f %8.1f\n", name.c_str(), engine.name, ms, res.ns_per_key, res.mad);
+#endif
+        }
+    }
+
+    if (!save_path.empty()) {
+        if (!save_baseline(save_path, n, trials, results)) {
+            std::fprintf(stderr, "cannot write baseline %s\n", save_path.c_str());
+            return 1;
+        }
+        std::printf("\nBaseline written to %s\n", save_path.c_str());
+    }
+    if (!check_path.empty()) {
+        int regressions = check_baseline(results, baseline, threshold);
+        std::printf("\n%d regression%s against %s\n", regressions, regressions == 1 ? "" : "s", check_path.c_str());
+        if (regressions) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+
+// --- Order-Preserving Key Compression (HOPE-style) ---
+//
+// The string space is cut into ordered intervals [B_i, B_i+1). Boundaries are
+// every single byte plus, for each frequent substring g found in a sample,
+// g itself and the first string after all strings starting with g. Every
+// interval has a non-empty common prefix P_i (at least its first byte).
+//
+// Encoding walks the key: find the interval holding the remaining suffix,
+// emit that interval's code and drop P_i from the suffix. Frequent substrings
+// are therefore consumed in one step. Interval codes are an alphabetic
+// (order-preserving) prefix-free code, so comparing encodings compares keys.
+//
+// Encoded bits are packed 7 per byte as 0x80 | bits: the result never holds a
+// zero byte, so it stays a valid C string for the sort engine, and an END code
+// (smaller than every interval) keeps "abc" ordered before "abcd".
+class KeyCodec {
+public:
+    // Trains a dictionary of up to max_grams substrings (2..max_gram_len bytes)
+    // on a sample of the keys to be sorted.
+    static KeyCodec train(const std::vector<std::string>& sample, size_t max_grams = 1024,
+                          size_t max_gram_len = 8) {
+        // 1. Count candidate substrings
+        std::unordered_map<std::string, uint32_t> counts;
+        for (const auto& key : sample) {
+            const char* s = key.c_str();
+            size_t len = strnlen(s, key.size());
+            for (size_t p = 0; p < len; ++p) {
+                for (size_t g = 2; g <= max_gram_len && p + g <= len; ++g) {
+                    counts[std::string(s + p, g)]++;
+                }
+            }
+        }
+
+        // 2. Keep the substrings saving the most bytes
+        std::vector<std::pair<uint64_t, std::string>> scored;
+        for (auto& kv : counts) {
+            if (kv.second < 2) continue;
+            scored.emplace_back(static_cast<uint64_t>(kv.second) * (kv.first.size() - 1), kv.first);
+        }
+        size_t keep = std::min(max_grams, scored.size());
+        std::partial_sort(scored.begin(), scored.begin() + keep, scored.end(),
+                          [](const std::pair<uint64_t, std::string>& a, const std::pair<uint64_t, std::string>& b) {
+                              return a.first > b.first || (a.first == b.first && a.second < b.second);
+                          });
+
+        // 3. Interval boundaries
+        KeyCodec codec;
+        std::vector<std::string>& bounds = codec.bounds_;
+        for (int c = 1; c < 256; ++c) bounds.emplace_back(1, static_cast<char>(c));
+        for (size_t g = 0; g < keep; ++g) {
+            const std::string& gram = scored[g].second;
+            bounds.push_back(gram);
+            std::string after = successor(gram);
+            if (!after.empty()) bounds.push_back(after);
+        }
+        std::sort(bounds.begin(), bounds.end());
+        bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+        // Common prefix of each interval: the longest prefix P of its lower
+        // boundary such that the upper boundary does not pass successor(P).
+        codec.consumed_.resize(bounds.size());
+        for (size_t i = 0; i < bounds.size(); ++i) {
+            const std::string& lo = bounds[i];
+            // The last interval is unbounded: only an all-0xFF prefix covers it.
+            size_t p = lo.size();
+            while (p > 1) {
+                std::string after = successor(lo.substr(0, p));
+                if (after.empty() || (i + 1 < bounds.size() && bounds[i + 1] <= after)) break;
+                p--;
+            }
+            codec.consumed_[i] = static_cast<uint8_t>(p);
+        }
+
+        // 4. Symbol weights from the sample, then alphabetic codes.
+        // Symbol 0 is END, symbol i + 1 is interval i.
+        std::vector<uint64_t> weight(bounds.size() + 1, 1);
+        weight[0] += sample.size();
+        for (const auto& key : sample) {
+            const char* s = key.c_str();
+            while (*s) {
+                size_t i = codec.find_interval(s);
+                weight[i + 1]++;
+                s += codec.consumed_[i];
+            }
+        }
+        codec.codes_.resize(weight.size());
+        codec.lengths_.resize(weight.size());
+        std::vector<uint64_t> prefix_sum(weight.size() + 1, 0);
+        for (size_t i = 0; i < weight.size(); ++i) prefix_sum[i + 1] = prefix_sum[i] + weight[i];
+        codec.assign_codes(prefix_sum, 0, weight.size() - 1, 0, 0);
+        return codec;
+    }
+
+    // Trains on an evenly spaced sample of the data itself.
+    static KeyCodec train_on(const std::vector<std::string>& data, size_t sample_size = 4096) {
+        std::vector<std::string> sample;
+        size_t step = std::max<size_t>(1, data.size() / sample_size);
+        for (size_t i = 0; i < data.size(); i += step) sample.push_back(data[i]);
+        return train(sample);
+    }
+
+    // Appends the encoding of key (without terminator) to out.
+    void encode(const char* key, std::string& out) const {
+        BitWriter writer(out);
+        while (*key) {
+            size_t i = find_interval(key);
+            writer.put(codes_[i + 1], lengths_[i + 1]);
+            key += consumed_[i];
+        }
+        writer.put(codes_[0], lengths_[0]);
+        writer.flush();
+    }
+
+    std::string decode(const char* encoded) const {
+        std::string out;
+        BitReader reader(encoded);
+        while (true) {
+            uint32_t peek = reader.peek32();
+            // Alphabetic codes: the symbol is the last one whose left-justified
+            // code does not exceed the next 32 bits.
+            size_t lo = 0, hi = codes_.size() - 1;
+            while (lo < hi) {
+                size_t mid = (lo + hi + 1) / 2;
+                if (left_justified(mid) <= peek) lo = mid; else hi = mid - 1;
+            }
+            reader.skip(lengths_[lo]);
+            if (lo == 0) break;
+            out.append(bounds_[lo - 1], 0, consumed_[lo - 1]);
+        }
+        return out;
+    }
+
+    size_t dictionary_size() const { return bounds_.size(); }
+
+private:
+    static constexpr int kMaxCodeBits = 32;
+
+    std::vector<std::string> bounds_;  // sorted interval lower boundaries
+    std::vector<uint8_t> consumed_;    // common prefix length of each interval
+    std::vector<uint32_t> codes_;      // per symbol (END, then intervals), right-aligned
+    std::vector<uint8_t> lengths_;     // code lengths in bits
+
+    // First string greater than every string starting with s ("" if none).
+    static std::string successor(std::string s) {
+        while (!s.empty() && static_cast<unsigned char>(s.back()) == 0xFF) s.pop_back();
+        if (!s.empty()) s.back() = static_cast<char>(static_cast<unsigned char>(s.back()) + 1);
+        return s;
+    }
+
+    // Index of the interval holding the non-empty string s.
+    size_t find_interval(const char* s) const {
+        size_t lo = 0, hi = bounds_.size() - 1;
+        while (lo < hi) {
+            size_t mid = (lo + hi + 1) / 2;
+            if (compare_prefix(bounds_[mid], s) <= 0) lo = mid; else hi = mid - 1;
+        }
+        return lo;
+    }
+
+    // strcmp of a boundary against a C string, unsigned byte order.
+    static int compare_prefix(const std::string& bound, const char* s) {
+        for (size_t k = 0; k < bound.size(); ++k) {
+            unsigned char b = static_cast<unsigned char>(bound[k]);
+            unsigned char c = static_cast<unsigned char>(s[k]);
+            if (b != c) return (b < c) ? -1 : 1;
+        }
+        return s[bound.size()] ? -1 : 0;
+    }
+
+    uint32_t left_justified(size_t sym) const {
+        return static_cast<uint32_t>(static_cast<uint64_t>(codes_[sym]) << (kMaxCodeBits - lengths_[sym]));
+    }
+
+    // Weight-balanced alphabetic code: split the ordered symbols where the
+    // two halves weigh the same, 0 to the left, 1 to the right. Splits are
+    // limited so that no code grows beyond kMaxCodeBits.
+    void assign_codes(const std::vector<uint64_t>& prefix_sum, size_t lo, size_t hi, uint32_t code, int len) {
+        if (lo == hi) {
+            codes_[lo] = code;
+            lengths_[lo] = static_cast<uint8_t>(len == 0 ? 1 : len);
+            return;
+        }
+        size_t cap = size_t(1) << std::min(kMaxCodeBits - len - 1, 30);
+        size_t first = (hi - lo + 1 > cap) ? hi - cap : lo;
+        size_t last = std::min(hi - 1, lo + cap - 1);
+        size_t split = first;
+        uint64_t best = UINT64_MAX;
+        for (size_t m = first; m <= last; ++m) {
+            uint64_t left = prefix_sum[m + 1] - prefix_sum[lo];
+            uint64_t right = prefix_sum[hi + 1] - prefix_sum[m + 1];
+            uint64_t gap = (left > right) ? left - right : right - left;
+            if (gap < best) { best = gap; split = m; }
+        }
+        assign_codes(prefix_sum, lo, split, code << 1, len + 1);
+        assign_codes(prefix_sum, split + 1, hi, (code << 1) | 1, len + 1);
+    }
+
+    struct BitWriter {
+        std::string& out;
+        uint32_t acc = 0;
+        int fill = 0;
+        explicit BitWriter(std::string& o) : out(o) {}
+        void put(uint32_t code, int len) {
+            for (int b = len - 1; b >= 0; --b) {
+                acc = (acc << 1) | ((code >> b) & 1);
+                if (++fill == 7) {
+                    out.push_back(static_cast<char>(0x80 | acc));
+                    acc = 0;
+                    fill = 0;
+                }
+            }
+        }
+        void flush() {
+            if (fill) out.push_back(static_cast<char>(0x80 | (acc << (7 - fill))));
+        }
+    };
+
+    struct BitReader {
+        const unsigned char* p;
+        int used = 0;  // bits consumed from *p
+        explicit BitReader(const char* s) : p(reinterpret_cast<const unsigned char*>(s)) {}
+        uint32_t peek32() const {
+            uint32_t v = 0;
+            const unsigned char* q = p;
+            int u = used, got = 0;
+            while (got < 32) {
+                uint32_t bits = *q ? (*q & 0x7F) : 0;
+                int take = std::min(7 - u, 32 - got);
+                v = (v << take) | ((bits >> (7 - u - take)) & ((1u << take) - 1));
+                got += take;
+                u += take;
+                if (u == 7) {
+                    if (*q) q++;
+                    u = 0;
+                }
+            }
+            return v;
+        }
+        void skip(int bits) {
+            used += bits;
+            p += used / 7;
+            used %= 7;
+        }
+    };
+};
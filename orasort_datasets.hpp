@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+// --- Synthetic Corpora ---
+//
+// Deterministic generators for the key shapes the engines are meant for. The
+// same (name, count, seed) always gives the same keys, on every platform: all
+// randomness comes from mt19937_64 and is turned into choices without the
+// implementation-defined std:: distributions.
+//
+//   urls   scheme, domain and path hierarchy, skewed towards popular sites
+//   paths  file system paths under a few deep project trees
+//   logs   log lines led by an ISO timestamp, nearly in time order
+//   uuids  random version 4 UUIDs
+//   dna    sequencing reads sampled, with errors, from one reference genome
+//   words  dictionary words built from stems, prefixes and suffixes
+//   zipf   Zipf-distributed (s = 1.1) duplicates of a 1% key population
+//
+// Keys never hold a newline or a NUL byte, so a corpus round-trips through
+// write_keys / read_keys as one key per line.
+class DatasetGenerator {
+public:
+    static const std::vector<std::string>& names() {
+        static const std::vector<std::string> all = {"urls", "paths", "logs", "uuids", "dna", "words", "zipf"};
+        return all;
+    }
+
+    // Returns an empty vector for an unknown name.
+    static std::vector<std::string> generate(const std::string& name, size_t count, uint64_t seed = 42) {
+        Rng rng(seed);
+        if (name == "urls") return urls(rng, count);
+        if (name == "paths") return paths(rng, count);
+        if (name == "logs") return logs(rng, count);
+        if (name == "uuids") return uuids(rng, count);
+        if (name == "dna") return dna(rng, count);
+        if (name == "words") return words(rng, count);
+        if (name == "zipf") return zipf(rng, count);
+        return {};
+    }
+
+    static bool write_keys(const std::string& path, const std::vector<std::string>& keys) {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) return false;
+        for (const auto& key : keys) {
+            out.write(key.data(), static_cast<std::streamsize>(key.size()));
+            out.put('\n');
+        }
+        return static_cast<bool>(out);
+    }
+
+    static bool read_keys(const std::string& path, std::vector<std::string>& keys) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            keys.push_back(line);
+        }
+        return in.eof();
+    }
+
+private:
+    struct Rng {
+        std::mt19937_64 engine;
+        explicit Rng(uint64_t seed) : engine(seed) {}
+
+        uint64_t below(uint64_t n) { return engine() % n; }
+        double unit() { return (engine() >> 11) * (1.0 / 9007199254740992.0); }
+        bool chance(double p) { return unit() < p; }
+
+        template <typename T>
+        const T& pick(const std::vector<T>& v) { return v[below(v.size())]; }
+    };
+
+    // Inverse CDF sampling of ranks 0..n-1 with P(k) proportional to 1/(k+1)^s.
+    class Zipf {
+    public:
+        Zipf(size_t n, double s) : cdf_(n) {
+            double sum = 0;
+            for (size_t k = 0; k < n; ++k) cdf_[k] = (sum += 1.0 / std::pow(static_cast<double>(k + 1), s));
+            for (auto& c : cdf_) c /= sum;
+        }
+        size_t operator()(Rng& rng) const {
+            size_t k = std::lower_bound(cdf_.begin(), cdf_.end(), rng.unit()) - cdf_.begin();
+            return std::min(k, cdf_.size() - 1);
+        }
+
+    private:
+        std::vector<double> cdf_;
+    };
+
+    static std::string hex(Rng& rng, int digits) {
+        static const char* const kHex = "0123456789abcdef";
+        std::string s;
+        for (int d = 0; d < digits; ++d) s += kHex[rng.below(16)];
+        return s;
+    }
+
+    static std::string syllables(Rng& rng, int min_count, int max_count) {
+        static const std::vector<std::string> kSyllables = {
+            "ka", "ro", "mi", "ten", "lo", "sa", "ver", "dan", "el", "tor", "pi", "na", "gra", "bel", "co",
+            "stra", "qui", "fen", "du", "mar", "is", "on", "al", "ex", "pre", "lu", "ri", "zo", "ham", "ne"};
+        int count = min_count + static_cast<int>(rng.below(max_count - min_count + 1));
+        std::string s;
+        for (int k = 0; k < count; ++k) s += rng.pick(kSyllables);
+        return s;
+    }
+
+    static std::vector<std::string> urls(Rng& rng, size_t count) {
+        static const std::vector<std::string> kTlds = {"com", "org", "net", "io", "de", "co.uk"};
+        static const std::vector<std::string> kSections = {"news", "products", "blog", "docs", "search", "user",
+                                                           "category", "api/v2", "static/img", "help"};
+        std::vector<std::string> domains(std::max<size_t>(count / 100, 16));
+        for (auto& d : domains) d = syllables(rng, 1, 3) + "." + rng.pick(kTlds);
+        std::vector<std::string> topics(256);
+        for (auto& t : topics) t = syllables(rng, 1, 4);
+        Zipf popularity(domains.size(), 1.0);
+
+        std::vector<std::string> keys(count);
+        for (auto& key : keys) {
+            key = rng.chance(0.8) ? "https://" : "http://";
+            if (rng.chance(0.7)) key += "www.";
+            key += domains[popularity(rng)];
+            key += "/" + rng.pick(kSections);
+            for (int depth = static_cast<int>(rng.below(4)); depth > 0; --depth) key += "/" + rng.pick(topics);
+            if (rng.chance(0.3)) key += "?id=" + std::to_string(rng.below(1000000));
+        }
+        return keys;
+    }
+
+    static std::vector<std::string> paths(Rng& rng, size_t count) {
+        static const std::vector<std::string> kRoots = {"/home/alice/src/", "/home/bob/work/", "/var/lib/build/",
+                                                        "/usr/share/doc/", "/opt/vendor/sdk/"};
+        static const std::vector<std::string> kExtensions = {".c", ".h", ".cpp", ".py", ".md", ".json", ".o", ""};
+        // A fixed tree of directories, each level with few children, so
+        // siblings share long prefixes the way real checkouts do.
+        std::vector<std::string> dirs;
+        for (size_t d = 0; d < std::max<size_t>(count / 20, 8); ++d) {
+            std::string dir = rng.pick(kRoots);
+            if (!dirs.empty() && rng.chance(0.6)) dir = rng.pick(dirs);
+            dirs.push_back(dir + syllables(rng, 1, 3) + "/");
+        }
+        std::vector<std::string> keys(count);
+        for (auto& key : keys) {
+            key = rng.pick(dirs) + syllables(rng, 1, 4);
+            if (rng.chance(0.2)) key += "_" + std::to_string(rng.below(100));
+            key += rng.pick(kExtensions);
+        }
+        return keys;
+    }
+
+    static std::vector<std::string> logs(Rng& rng, size_t count) {
+        static const std::vector<std::string> kLevels = {"INFO ", "INFO ", "INFO ", "DEBUG", "WARN ", "ERROR"};
+        static const std::vector<std::string> kServices = {"api-gateway", "auth", "billing", "scheduler",
+                                                           "storage", "search-indexer"};
+        static const std::vector<std::string> kMessages = {
+            "request completed status=200", "request completed status=404", "cache miss for key",
+            "retrying connection to upstream", "user session created", "flushed segment to disk",
+            "slow query detected", "health check ok"};
+        // Milliseconds since 2026-03-01T00:00:00Z; lines from several hosts
+        // interleave, so time order holds only up to a small jitter.
+        uint64_t clock = 0;
+        std::vector<std::string> keys(count);
+        char stamp[64];
+        for (auto& key : keys) {
+            clock += rng.below(50);
+            uint64_t t = clock + rng.below(200);
+            uint64_t ms = t % 1000, s = t / 1000 % 60, m = t / 60000 % 60, h = t / 3600000 % 24;
+            uint64_t day = 1 + t / 86400000 % 28;
+            std::snprintf(stamp, sizeof(stamp), "2026-03-%02llu %02llu:%02llu:%02llu.%03llu ",
+                          static_cast<unsigned long long>(day), static_cast<unsigned long long>(h),
+                          static_cast<unsigned long long>(m), static_cast<unsigned long long>(s),
+                          static_cast<unsigned long long>(ms));
+            key = stamp + rng.pick(kLevels) + " " + rng.pick(kServices) + "[" +
+                  std::to_string(1000 + rng.below(64)) + "]: " + rng.pick(kMessages);
+        }
+        return keys;
+    }
+
+    static std::vector<std::string> uuids(Rng& rng, size_t count) {
+        static const char* const kVariant = "89ab";
+        std::vector<std::string> keys(count);
+        for (auto& key : keys) {
+            key = hex(rng, 8) + "-" + hex(rng, 4) + "-4" + hex(rng, 3) + "-" + kVariant[rng.below(4)] + hex(rng, 3) +
+                  "-" + hex(rng, 12);
+        }
+        return keys;
+    }
+
+    static std::vector<std::string> dna(Rng& rng, size_t count) {
+        static const char kBases[] = "ACGT";
+        // About 30x coverage: overlapping reads share long prefixes.
+        const size_t read_len = 150;
+        std::string genome(std::max<size_t>(count * read_len / 30, 4 * read_len), 'A');
+        for (auto& base : genome) base = kBases[rng.below(4)];
+        std::vector<std::string> keys(count);
+        for (auto& key : keys) {
+            size_t len = 100 + rng.below(read_len - 100 + 1);
+            key = genome.substr(rng.below(genome.size() - len + 1), len);
+            for (auto& base : key) {
+                if (rng.chance(0.01)) base = kBases[rng.below(4)];
+            }
+        }
+        return keys;
+    }
+
+    static std::vector<std::string> words(Rng& rng, size_t count) {
+        static const std::vector<std::string> kPrefixes = {"", "", "", "", "un", "re", "pre", "over", "inter", "dis"};
+        static const std::vector<std::string> kSuffixes = {"", "", "", "s", "ed", "ing", "er", "ly", "ness",
+                                                           "ation", "able"};
+        std::vector<std::string> stems(std::max<size_t>(count / 8, 16));
+        for (auto& stem : stems) stem = syllables(rng, 1, 3);
+        std::vector<std::string> keys(count);
+        for (auto& key : keys) key = rng.pick(kPrefixes) + rng.pick(stems) + rng.pick(kSuffixes);
+        return keys;
+    }
+
+    static std::vector<std::string> zipf(Rng& rng, size_t count) {
+        std::vector<std::string> population(std::max<size_t>(count / 100, 1));
+        for (auto& key : population) key = "customer:" + hex(rng, 6) + ":" + syllables(rng, 1, 2);
+        Zipf rank(population.size(), 1.1);
+        std::vector<std::string> keys(count);
+        for (auto& key : keys) key = population[rank(rng)];
+        return keys;
+    }
+};
@@ -0,0 +1,45 @@
+// Writes the synthetic corpora of orasort_datasets.hpp to disk, one key per line.
+//
+//   g++ -O2 -std=c++17 orasort_gen.cpp -o orasort_gen
+//   ./orasort_gen <dir> [count] [seed] [dataset...]
+//
+// Each dataset goes to <dir>/<dataset>-<count>.txt; count defaults to one
+// million keys, the datasets to all of them.
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "orasort_datasets.hpp"
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <dir> [count] [seed] [dataset...]\n", argv[0]);
+        return 2;
+    }
+    std::string dir = argv[1];
+    size_t count = 1000000;
+    uint64_t seed = 42;
+    int a = 2;
+    if (a < argc && std::isdigit(static_cast<unsigned char>(argv[a][0]))) count = std::strtoull(argv[a++], nullptr, 10);
+    if (a < argc && std::isdigit(static_cast<unsigned char>(argv[a][0]))) seed = std::strtoull(argv[a++], nullptr, 10);
+    std::vector<std::string> datasets(argv + a, argv + argc);
+    if (datasets.empty()) datasets = DatasetGenerator::names();
+
+    for (const auto& name : datasets) {
+        std::vector<std::string> keys = DatasetGenerator::generate(name, count, seed);
+        if (keys.empty() && count > 0) {
+            std::fprintf(stderr, "unknown dataset: %s\n", name.c_str());
+            return 1;
+        }
+        std::string path = dir + "/" + name + "-" + std::to_string(count) + ".txt";
+        if (!DatasetGenerator::write_keys(path, keys)) {
+            std::fprintf(stderr, "cannot write %s\n", path.c_str());
+            return 1;
+        }
+        std::printf("%s: %zu keys\n", path.c_str(), keys.size());
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// --- Key Projections ---
+//
+// The range APIs of LegrandSort and OptimizedOrasort sort any random-access
+// range by a key projected from each element: a member pointer (&Row::key),
+// a lambda, or the element itself. A projection may return:
+//
+//   const std::string& / const char*   a NUL-terminated key living in the element
+//   std::string_view / std::string     any other key; OptimizedOrasort copies
+//                                      these into a terminated arena first
+//
+// Keys must not contain NUL bytes.
+
+struct KeyIdentity {
+    template <typename T>
+    constexpr T&& operator()(T&& value) const noexcept {
+        return std::forward<T>(value);
+    }
+};
+
+template <typename Proj, typename It>
+using projected_key_t = decltype(std::invoke(std::declval<Proj&>(), *std::declval<It&>()));
+
+// Keys that OptimizedOrasort can point into directly: their terminator
+// is guaranteed and they outlive the projection call.
+template <typename Key>
+constexpr bool is_terminated_key_v =
+    (std::is_lvalue_reference_v<Key> && std::is_same_v<std::decay_t<Key>, std::string>) ||
+    std::is_convertible_v<Key, const char*>;
+
+// Keys that stay valid after the projection call returns.
+template <typename Key>
+constexpr bool is_borrowed_key_v = std::is_lvalue_reference_v<Key> || std::is_convertible_v<Key, const char*> ||
+                                   std::is_same_v<std::decay_t<Key>, std::string_view>;
+
+// Enables the range overloads for types with begin()/end() only, so that
+// (first, last) iterator pairs do not bind to them.
+template <typename Range>
+using enable_if_range_t = decltype(std::begin(std::declval<Range&>()), std::end(std::declval<Range&>()), void());
+
+// Enables the projection overloads only for projections callable on the
+// elements, so that other second arguments (a thread count, a codec) pick
+// their own overloads.
+template <typename Proj, typename It>
+using enable_if_projection_t = std::enable_if_t<std::is_invocable_v<Proj&, decltype(*std::declval<It&>())>>;
+
+inline std::string_view key_view(const std::string& key) { return key; }
+inline std::string_view key_view(std::string_view key) { return key; }
+inline std::string_view key_view(const char* key) { return std::string_view(key, std::strlen(key)); }
+
+inline const char* key_c_str(const std::string& key) { return key.c_str(); }
+inline const char* key_c_str(const char* key) { return key; }
+
+// Moves the element at first[order[k]] to position k for every k, cycle by
+// cycle through one temporary, so each element is moved about once and
+// nothing is copied. Leaves order as the identity.
+template <typename RandomIt>
+void apply_permutation(RandomIt first, std::vector<size_t>& order) {
+    for (size_t start = 0; start < order.size(); ++start) {
+        if (order[start] == start) continue;
+        auto saved = std::move(first[start]);
+        size_t k = start;
+        while (order[k] != start) {
+            const size_t from = order[k];
+            first[k] = std::move(first[from]);
+            order[k] = k;
+            k = from;
+        }
+        first[k] = std::move(saved);
+        order[k] = k;
+    }
+}
@@ -0,0 +1,335 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "orasort_key.hpp"
+#include "orasort_profile.hpp"
+#include "orasort_trace.hpp"
+
+// --- LCP Merge Sort ---
+//
+// A stable alternative to the quicksort core of OptimizedOrasort. Each
+// thread merge sorts a chunk of the input and keeps, next to every key, its
+// longest common prefix (LCP) with the key before it. Merging two sorted
+// runs then needs no bytes for most steps: with h1 and h2 the LCPs of the
+// two fronts with the last key output, h1 > h2 means the first front is the
+// smaller one, and only h1 == h2 compares, from byte h1 on. A loser tree
+// merges the chunks the same way, each thread merging the slice of every
+// chunk between two splitter keys, so every thread writes and mostly reads
+// memory it sorted itself.
+//
+// The total bytes inspected stay close to the distinguishing prefixes of
+// the keys, which is where this wins: long shared prefixes (URLs, paths)
+// and keys that must keep their input order when equal.
+
+class LcpMergeSort {
+public:
+    // Sorts [first, last) by the NUL-terminated keys proj projects from the
+    // elements (std::string references or const char*, see orasort_key.hpp),
+    // keeping equal keys in input order. Elements are moved into sorted order
+    // at the end.
+    template <typename RandomIt, typename Proj = KeyIdentity, typename = enable_if_projection_t<Proj, RandomIt>>
+    static void sort(RandomIt first, RandomIt last, Proj proj = {}) {
+        sort_range(first, last, proj, 1);
+    }
+
+    template <typename Range, typename Proj = KeyIdentity, typename = enable_if_range_t<Range>,
+              typename = enable_if_projection_t<Proj, decltype(std::begin(std::declval<Range&>()))>>
+    static void sort(Range& range, Proj proj = {}) {
+        sort_range(std::begin(range), std::end(range), proj, 1);
+    }
+
+    // Parallel variants: one chunk per thread, then one merge slice per thread.
+    template <typename RandomIt, typename Proj, typename = enable_if_projection_t<Proj, RandomIt>>
+    static void sort_parallel(RandomIt first, RandomIt last, Proj proj,
+                              unsigned threads = std::thread::hardware_concurrency()) {
+        sort_range(first, last, proj, threads);
+    }
+
+    template <typename Range, typename Proj, typename = enable_if_range_t<Range>,
+              typename = enable_if_projection_t<Proj, decltype(std::begin(std::declval<Range&>()))>>
+    static void sort_parallel(Range& range, Proj proj, unsigned threads = std::thread::hardware_concurrency()) {
+        sort_range(std::begin(range), std::end(range), proj, threads);
+    }
+
+    template <typename Range, typename = enable_if_range_t<Range>>
+    static void sort_parallel(Range& range, unsigned threads = std::thread::hardware_concurrency()) {
+        KeyIdentity identity;
+        sort_range(std::begin(range), std::end(range), identity, threads);
+    }
+
+    struct MergeItem {
+        const char* ptr;  // NUL-terminated key
+        size_t index;     // position of the key's element in the input
+    };
+
+    // Sorts items stably by their keys.
+    static void sort_items(std::vector<MergeItem>& items, unsigned threads = 1) {
+        const size_t n = items.size();
+        if (n < 2) return;
+        if (threads < 1) threads = 1;
+        if (threads > n / kMinChunk) threads = std::max<size_t>(1, n / kMinChunk);
+
+        std::vector<MergeItem> buffer(n);
+        std::vector<uint32_t> lcp(n), lcp_buffer(n);
+        std::vector<size_t> chunk(threads + 1);
+        for (unsigned t = 0; t <= threads; ++t) chunk[t] = n * t / threads;
+
+        run_threads(threads, [&](unsigned t) {
+            TraceSpan span("merge sort chunk", "sort", chunk[t + 1] - chunk[t]);
+            merge_sort(items.data() + chunk[t], lcp.data() + chunk[t], buffer.data() + chunk[t],
+                       lcp_buffer.data() + chunk[t], chunk[t + 1] - chunk[t], false);
+        });
+        if (threads == 1) return;
+
+        // bounds[t][c]: where slice t starts in chunk c. Splitting at the
+        // first key not below a splitter keeps equal keys in one slice.
+        const std::vector<const char*> splitters = choose_splitters(items, chunk, threads);
+        std::vector<std::vector<size_t>> bounds(threads + 1, std::vector<size_t>(threads));
+        for (unsigned c = 0; c < threads; ++c) {
+            bounds[0][c] = chunk[c];
+            bounds[threads][c] = chunk[c + 1];
+            for (unsigned t = 1; t < threads; ++t) {
+                bounds[t][c] = static_cast<size_t>(
+                    std::lower_bound(items.data() + bounds[t - 1][c], items.data() + chunk[c + 1], splitters[t - 1],
+                                     [](const MergeItem& item, const char* key) {
+                                         ORASORT_COMPARE(1);
+                                         return std::strcmp(item.ptr, key) < 0;
+                                     }) -
+                    items.data());
+            }
+        }
+
+        run_threads(threads, [&](unsigned t) {
+            std::vector<Run> runs(threads);
+            size_t out = 0, size = 0;
+            for (unsigned c = 0; c < threads; ++c) {
+                runs[c].items = items.data() + bounds[t][c];
+                runs[c].lcp = lcp.data() + bounds[t][c];
+                runs[c].size = bounds[t + 1][c] - bounds[t][c];
+                out += bounds[t][c] - chunk[c];
+                size += runs[c].size;
+            }
+            TraceSpan span("multiway merge", "sort", size);
+            multiway_merge(runs, buffer.data() + out);
+        });
+        items.swap(buffer);
+    }
+
+private:
+    static constexpr size_t kInsertionMax = 12;  // runs sorted by insertion
+    static constexpr size_t kMinChunk = 4096;    // fewest items per thread
+    static constexpr size_t kOversample = 32;    // sample keys per splitter
+
+    // A sorted run and the LCPs of its keys with their predecessors (the
+    // first one is not read).
+    struct Run {
+        const MergeItem* items;
+        const uint32_t* lcp;
+        size_t size;
+    };
+
+    template <typename RandomIt, typename Proj>
+    static void sort_range(RandomIt first, RandomIt last, Proj& proj, unsigned threads) {
+        using Key = projected_key_t<Proj, RandomIt>;
+        static_assert(is_terminated_key_v<Key>,
+                      "LcpMergeSort points into the keys: project to a const std::string& or const char*");
+        const size_t n = static_cast<size_t>(last - first);
+        if (n < 2) return;
+
+        std::vector<MergeItem> items(n);
+        {
+            ORASORT_PHASE(CacheBuild);
+            for (size_t i = 0; i < n; ++i) items[i] = {key_c_str(std::invoke(proj, first[i])), i};
+        }
+        sort_items(items, threads);
+
+        ORASORT_PHASE(WriteBack);
+        TraceSpan span("write-back", "sort", n);
+        std::vector<size_t> order(n);
+        for (size_t k = 0; k < n; ++k) order[k] = items[k].index;
+        apply_permutation(first, order);
+    }
+
+    template <typename Body>
+    static void run_threads(unsigned threads, Body body) {
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; ++t) workers.emplace_back([&body, t] { body(t); });
+        body(0);
+        for (auto& w : workers) w.join();
+    }
+
+    // Compares a and b past their first h bytes, known to be equal, and
+    // stores the length of their common prefix in lcp.
+    static int compare_from(const char* a, const char* b, uint32_t h, uint32_t& lcp) {
+        ORASORT_COMPARE(1);
+        const unsigned char* x = reinterpret_cast<const unsigned char*>(a) + h;
+        const unsigned char* y = reinterpret_cast<const unsigned char*>(b) + h;
+        uint32_t k = 0;
+        while (x[k] != 0 && x[k] == y[k]) k++;
+        ORASORT_INSPECT(2 * (k + 1));
+        lcp = h + k;
+        return static_cast<int>(x[k]) - static_cast<int>(y[k]);
+    }
+
+    // Sorts a[0, n) stably and stores the LCPs in ha[1, n) (ha[0] = 0). The
+    // result lands in a, or in b and hb when into_b; b is scratch otherwise.
+    static void merge_sort(MergeItem* a, uint32_t* ha, MergeItem* b, uint32_t* hb, size_t n, bool into_b) {
+        if (n <= kInsertionMax) {
+            insertion_sort(a, ha, n);
+            if (into_b) {
+                std::copy(a, a + n, b);
+                std::copy(ha, ha + n, hb);
+            }
+            return;
+        }
+        const size_t m = n / 2;
+        merge_sort(a, ha, b, hb, m, !into_b);
+        merge_sort(a + m, ha + m, b + m, hb + m, n - m, !into_b);
+        ORASORT_PHASE(Merge);
+        if (into_b) {
+            lcp_merge({a, ha, m}, {a + m, ha + m, n - m}, b, hb);
+        } else {
+            lcp_merge({b, hb, m}, {b + m, hb + m, n - m}, a, ha);
+        }
+    }
+
+    static void insertion_sort(MergeItem* a, uint32_t* ha, size_t n) {
+        ORASORT_PHASE(SmallSort);
+        uint32_t lcp = 0;
+        for (size_t i = 1; i < n; ++i) {
+            const MergeItem item = a[i];
+            size_t j = i;
+            while (j > 0 && compare_from(a[j - 1].ptr, item.ptr, 0, lcp) > 0) {
+                a[j] = a[j - 1];
+                j--;
+            }
+            a[j] = item;
+        }
+        ha[0] = 0;
+        for (size_t i = 1; i < n; ++i) {
+            compare_from(a[i - 1].ptr, a[i].ptr, 0, lcp);
+            ha[i] = lcp;
+        }
+    }
+
+    // Merges two runs into out and ho. h1 and h2 are the LCPs of the fronts
+    // with the last key output; ties go to the first run.
+    static void lcp_merge(Run r1, Run r2, MergeItem* out, uint32_t* ho) {
+        size_t i = 0, j = 0, o = 0;
+        uint32_t h1 = 0, h2 = 0;
+        while (i < r1.size && j < r2.size) {
+            bool first = h1 > h2;
+            if (h1 == h2) {
+                uint32_t lcp = 0;
+                first = compare_from(r1.items[i].ptr, r2.items[j].ptr, h1, lcp) <= 0;
+                if (first) {
+                    h2 = lcp;
+                } else {
+                    h1 = lcp;
+                }
+            }
+            if (first) {
+                out[o] = r1.items[i];
+                ho[o++] = h1;
+                if (++i < r1.size) h1 = r1.lcp[i];
+            } else {
+                out[o] = r2.items[j];
+                ho[o++] = h2;
+                if (++j < r2.size) h2 = r2.lcp[j];
+            }
+        }
+        copy_rest(r1, i, h1, out + o, ho + o);
+        copy_rest(r2, j, h2, out + o, ho + o);
+    }
+
+    // Copies the run from its front at i on; h is the LCP of the front with
+    // the last key output.
+    static void copy_rest(Run run, size_t i, uint32_t h, MergeItem* out, uint32_t* ho) {
+        if (i == run.size) return;
+        std::copy(run.items + i, run.items + run.size, out);
+        ho[0] = h;
+        std::copy(run.lcp + i + 1, run.lcp + run.size, ho + 1);
+    }
+
+    // Merges the runs into out with a loser tree. Each stream s keeps h[s],
+    // the LCP of its front with the key that beat it (the last key output
+    // for the fronts on the path just replayed), so matches decide by LCP
+    // like lcp_merge does. Ties go to the lower run, which keeps the merge
+    // stable; exhausted runs lose every match.
+    static void multiway_merge(const std::vector<Run>& runs, MergeItem* out) {
+        ORASORT_PHASE(Merge);
+        const unsigned k = static_cast<unsigned>(runs.size());
+        unsigned leaves = 1;
+        while (leaves < k) leaves <<= 1;
+        std::vector<size_t> pos(leaves, 0);
+        std::vector<uint32_t> h(leaves, 0);
+        std::vector<unsigned> loser(leaves);
+
+        auto exhausted = [&](unsigned s) { return s >= k || pos[s] == runs[s].size; };
+        // Plays a against b: returns the winner and stores the loser in lost.
+        auto play = [&](unsigned a, unsigned b, unsigned& lost) {
+            if (exhausted(b)) {
+                lost = b;
+                return a;
+            }
+            if (exhausted(a) || h[a] < h[b]) {
+                lost = a;
+                return b;
+            }
+            if (h[a] == h[b]) {
+                uint32_t lcp = 0;
+                const int cmp = compare_from(runs[a].items[pos[a]].ptr, runs[b].items[pos[b]].ptr, h[a], lcp);
+                if (cmp > 0 || (cmp == 0 && b < a)) {
+                    h[a] = lcp;
+                    lost = a;
+                    return b;
+                }
+                h[b] = lcp;
+            }
+            lost = b;
+            return a;
+        };
+
+        std::vector<unsigned> winner(2 * leaves);
+        for (unsigned s = 0; s < leaves; ++s) winner[leaves + s] = s;
+        for (unsigned node = leaves - 1; node >= 1; --node) {
+            winner[node] = play(winner[2 * node], winner[2 * node + 1], loser[node]);
+        }
+        unsigned top = winner[1];
+
+        for (size_t o = 0; !exhausted(top); ++o) {
+            out[o] = runs[top].items[pos[top]];
+            if (++pos[top] < runs[top].size) h[top] = runs[top].lcp[pos[top]];
+            for (unsigned node = (leaves + top) / 2; node >= 1; node /= 2) {
+                top = play(top, loser[node], loser[node]);
+            }
+        }
+    }
+
+    // Picks threads - 1 splitter keys from a regular sample of the sorted chunks.
+    static std::vector<const char*> choose_splitters(const std::vector<MergeItem>& items,
+                                                     const std::vector<size_t>& chunk, unsigned threads) {
+        std::vector<const char*> sample;
+        const size_t per_chunk = kOversample * threads;
+        for (unsigned c = 0; c < threads; ++c) {
+            const size_t size = chunk[c + 1] - chunk[c];
+            for (size_t s = 0; s < per_chunk; ++s) sample.push_back(items[chunk[c] + size * s / per_chunk].ptr);
+        }
+        std::sort(sample.begin(), sample.end(), [](const char* a, const char* b) {
+            ORASORT_COMPARE(1);
+            return std::strcmp(a, b) < 0;
+        });
+        std::vector<const char*> splitters(threads - 1);
+        for (unsigned t = 1; t < threads; ++t) splitters[t - 1] = sample[sample.size() * t / threads];
+        return splitters;
+    }
+};
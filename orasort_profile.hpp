@@ -0,0 +1,266 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// --- Per-Phase Hardware Counter Profiling ---
+//
+// Build with -DORASORT_PROFILE to wrap the phases of OptimizedOrasort with
+// perf_event counters (cycles, instructions, LLC misses, branch misses, dTLB
+// misses). Phases nest and are accounted exclusively: time spent in a slow-path
+// compare is charged to SlowCompare, not to the Partition that called it.
+// Counters only count user space, so the read() at each phase switch does not
+// show up in them, but it does in the wall time of fine-grained phases.
+// Where perf_event_open is unavailable (non-Linux, containers, a strict
+// perf_event_paranoid) the report falls back to calls and wall time.
+// Counters are per thread: a worker's totals (sort_parallel partitions and
+// networks) are merged into a shared pool when the worker exits, and every
+// report adds that pool to the calling thread's own totals.
+// Without ORASORT_PROFILE the ORASORT_PHASE markers compile to nothing.
+
+enum class SortPhase { CacheBuild, PrefixScan, Partition, SmallSort, RefreshCache, SlowCompare, WriteBack, Merge, Count };
+
+inline const char* sort_phase_name(SortPhase phase) {
+    static const char* const names[] = {"cache build", "prefix scan", "partition", "small sort",
+                                        "refresh cache", "slow compare", "write-back", "merge"};
+    return names[static_cast<int>(phase)];
+}
+
+class PhaseProfiler {
+public:
+    enum Counter { Cycles, Instructions, LLCMisses, BranchMisses, DTLBMisses, kCounters };
+
+    // Counters belong to the calling thread, so each thread gets its own profiler.
+    static PhaseProfiler& instance() {
+        thread_local PhaseProfiler profiler;
+        return profiler;
+    }
+
+    ~PhaseProfiler() {
+        {
+            Retired& pool = retired();
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            add_totals(pool.totals, totals_);
+        }
+#ifdef __linux__
+        for (int c = 0; c < kCounters; ++c) {
+            if (fd_[c] >= 0) close(fd_[c]);
+        }
+#endif
+    }
+
+    void enter(SortPhase phase) {
+        charge();
+        stack_.push_back(phase);
+        totals_[static_cast<int>(phase)].calls++;
+    }
+
+    void exit() {
+        charge();
+        stack_.pop_back();
+    }
+
+    // Clears this thread's totals and those merged from exited workers.
+    void reset() {
+        std::memset(totals_, 0, sizeof(totals_));
+        Retired& pool = retired();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        std::memset(pool.totals, 0, sizeof(pool.totals));
+    }
+
+    bool has_counters() const { return available_ > 0; }
+
+    void report(std::ostream& out) const {
+        static const char* const counter_names[] = {"cycles", "instr", "LLC-miss", "br-miss", "dTLB-miss"};
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-14s %10s %10s", "phase", "calls", "ms");
+        out << line;
+        for (int c = 0; c < kCounters; ++c) {
+            if (fd_[c] < 0) continue;
+            std::snprintf(line, sizeof(line), " %14s", counter_names[c]);
+            out << line;
+        }
+        if (fd_[Cycles] >= 0 && fd_[Instructions] >= 0) out << "    IPC";
+        out << "\n";
+
+        PhaseTotals totals[static_cast<int>(SortPhase::Count)];
+        std::memcpy(totals, totals_, sizeof(totals));
+        {
+            Retired& pool = retired();
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            add_totals(totals, pool.totals);
+        }
+        for (int p = 0; p < static_cast<int>(SortPhase::Count); ++p) {
+            const PhaseTotals& t = totals[p];
+            if (t.calls == 0) continue;
+            std::snprintf(line, sizeof(line), "%-14s %10llu %10.3f", sort_phase_name(static_cast<SortPhase>(p)),
+                          static_cast<unsigned long long>(t.calls), t.nanos / 1e6);
+            out << line;
+            for (int c = 0; c < kCounters; ++c) {
+                if (fd_[c] < 0) continue;
+                std::snprintf(line, sizeof(line), " %14llu", static_cast<unsigned long long>(t.counts[c]));
+                out << line;
+            }
+            if (fd_[Cycles] >= 0 && fd_[Instructions] >= 0) {
+                double ipc = t.counts[Cycles] ? static_cast<double>(t.counts[Instructions]) / t.counts[Cycles] : 0.0;
+                std::snprintf(line, sizeof(line), " %6.2f", ipc);
+                out << line;
+            }
+            out << "\n";
+        }
+        if (!has_counters()) out << "(hardware counters unavailable: timing only)\n";
+    }
+
+private:
+    struct PhaseTotals {
+        uint64_t calls;
+        uint64_t nanos;
+        uint64_t counts[kCounters];
+    };
+
+    // Totals of threads that have exited.
+    struct Retired {
+        std::mutex mutex;
+        PhaseTotals totals[static_cast<int>(SortPhase::Count)] = {};
+    };
+
+    static Retired& retired() {
+        static Retired pool;
+        return pool;
+    }
+
+    static void add_totals(PhaseTotals* into, const PhaseTotals* from) {
+        for (int p = 0; p < static_cast<int>(SortPhase::Count); ++p) {
+            into[p].calls += from[p].calls;
+            into[p].nanos += from[p].nanos;
+            for (int c = 0; c < kCounters; ++c) into[p].counts[c] += from[p].counts[c];
+        }
+    }
+
+    int fd_[kCounters];
+    int available_ = 0;
+    uint64_t last_[kCounters] = {};
+    std::chrono::steady_clock::time_point last_time_;
+    std::vector<SortPhase> stack_;  // open phases, innermost last (they nest with the recursion)
+    PhaseTotals totals_[static_cast<int>(SortPhase::Count)] = {};
+
+    PhaseProfiler() {
+        for (int c = 0; c < kCounters; ++c) fd_[c] = -1;
+#ifdef __linux__
+        const uint32_t dtlb_read_miss = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        open_counter(Cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        open_counter(Instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        open_counter(LLCMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        open_counter(BranchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        open_counter(DTLBMisses, PERF_TYPE_HW_CACHE, dtlb_read_miss);
+#endif
+        stack_.reserve(256);
+        read_counters(last_);
+        last_time_ = std::chrono::steady_clock::now();
+    }
+
+#ifdef __linux__
+    // Counters are opened one by one so that a PMU lacking one event still
+    // reports the others.
+    void open_counter(Counter counter, uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        if (fd < 0) return;
+        fd_[counter] = fd;
+        available_++;
+    }
+#endif
+
+    void read_counters(uint64_t* values) const {
+        for (int c = 0; c < kCounters; ++c) {
+            values[c] = 0;
+#ifdef __linux__
+            if (fd_[c] >= 0 && ::read(fd_[c], &values[c], sizeof(uint64_t)) != sizeof(uint64_t)) values[c] = 0;
+#endif
+        }
+    }
+
+    // Charges everything since the last phase switch to the innermost phase.
+    void charge() {
+        uint64_t now[kCounters];
+        read_counters(now);
+        auto now_time = std::chrono::steady_clock::now();
+        if (!stack_.empty()) {
+            PhaseTotals& t = totals_[static_cast<int>(stack_.back())];
+            t.nanos += static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now_time - last_time_).count());
+            for (int c = 0; c < kCounters; ++c) t.counts[c] += now[c] - last_[c];
+        }
+        std::memcpy(last_, now, sizeof(last_));
+        last_time_ = now_time;
+    }
+};
+
+struct PhaseScope {
+    explicit PhaseScope(SortPhase phase) { PhaseProfiler::instance().enter(phase); }
+    ~PhaseScope() { PhaseProfiler::instance().exit(); }
+    PhaseScope(const PhaseScope&) = delete;
+    PhaseScope& operator=(const PhaseScope&) = delete;
+};
+
+// --- Byte Inspection Accounting ---
+//
+// Build with -DORASORT_BYTE_STATS to count every key byte the sort engines
+// read: cache loads, slow-path scans, common prefix scans and the alphabet
+// analysis pass. Comparing the total with the distinguishing prefix size D of
+// the input (the bytes any string sort has to look at) shows how close an
+// engine comes to the lower bound. The same build counts key comparisons,
+// one per item a vector kernel classifies or a network compare-exchanges.
+// Without the flag ORASORT_INSPECT and ORASORT_COMPARE are no-ops.
+struct ByteInspection {
+    static std::atomic<uint64_t>& counter() {
+        static std::atomic<uint64_t> bytes{0};
+        return bytes;
+    }
+    static std::atomic<uint64_t>& compare_counter() {
+        static std::atomic<uint64_t> compares{0};
+        return compares;
+    }
+    static uint64_t bytes() { return counter().load(std::memory_order_relaxed); }
+    static uint64_t comparisons() { return compare_counter().load(std::memory_order_relaxed); }
+    static void reset() {
+        counter().store(0, std::memory_order_relaxed);
+        compare_counter().store(0, std::memory_order_relaxed);
+    }
+};
+
+#ifdef ORASORT_BYTE_STATS
+    #define ORASORT_INSPECT(n) ByteInspection::counter().fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed)
+    #define ORASORT_COMPARE(n) \
+        ByteInspection::compare_counter().fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed)
+#else
+    #define ORASORT_INSPECT(n) ((void)0)
+    #define ORASORT_COMPARE(n) ((void)0)
+#endif
+
+#ifdef ORASORT_PROFILE
+    #define ORASORT_PHASE_CONCAT2(a, b) a##b
+    #define ORASORT_PHASE_CONCAT(a, b) ORASORT_PHASE_CONCAT2(a, b)
+    #define ORASORT_PHASE(phase) PhaseScope ORASORT_PHASE_CONCAT(orasort_phase_, __LINE__)(SortPhase::phase)
+#else
+    #define ORASORT_PHASE(phase) ((void)0)
+#endif
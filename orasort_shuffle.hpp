@@ -0,0 +1,430 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "orasort2.hpp"
+#include "orasort_trace.hpp"
+
+// --- Local Shuffle ---
+//
+// The map side of a sort-based shuffle on one machine. Producer threads add
+// (partition, key, value) records. Once the buffered records reach half the
+// memory budget, the buffer is sorted by (partition, key) and spilled to a
+// run file, while producers go on filling a fresh buffer. finish() merges
+// the runs into one file per partition, sorted by key:
+//
+//   ShuffleWriter writer({"/tmp/shuffle", 64});  // directory, partitions
+//   writer.add(hash(user) % 64, user, event);    // from any thread
+//   writer.finish();
+//   ShuffleReader reader(writer.partition_path(7));
+//   reader.seek("user42");
+//   while (reader.next(key, value)) ...
+//
+// A partition file holds its records ([u32 key length][u32 value length]
+// [key][value]), then an offset index with every index_interval-th record
+// ([u64 offset][u32 key length][key]), then a footer ([u64 index offset]
+// [u64 index entries][u64 records][u64 magic]). Integers are in host byte
+// order: the files are meant for this machine. Keys must not contain NUL
+// bytes; values may hold anything. Records with equal keys come out in no
+// particular order.
+
+struct ShuffleOptions {
+    std::string directory = ".";     // run and partition files go here (must exist)
+    uint32_t partitions = 1;
+    size_t memory_budget = 64 << 20;  // bytes of buffered records (two buffers of half each)
+    unsigned sort_threads = 1;       // threads sorting one partition of a buffer
+    size_t index_interval = 128;     // records per offset index entry
+};
+
+class ShuffleWriter {
+public:
+    static constexpr uint64_t kMagic = 0x4F52534855464631ULL;  // "ORSHUFF1"
+
+    explicit ShuffleWriter(ShuffleOptions options) : options_(std::move(options)) {}
+
+    ~ShuffleWriter() {
+        for (const auto& run : runs_) std::remove(run.c_str());
+    }
+
+    ShuffleWriter(const ShuffleWriter&) = delete;
+    ShuffleWriter& operator=(const ShuffleWriter&) = delete;
+
+    // Buffers a record, spilling the buffer when it is full. Returns false
+    // for a partition out of range, or once a spill has failed.
+    bool add(uint32_t partition, std::string_view key, std::string_view value) {
+        if (partition >= options_.partitions) return false;
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (failed_) return false;
+        active_.add(partition, key, value);
+        if (active_.bytes() < options_.memory_budget / 2) return true;
+
+        // One spill at a time: the next full buffer waits for it.
+        lock.unlock();
+        std::lock_guard<std::mutex> spilling(spill_mutex_);
+        lock.lock();
+        if (active_.bytes() < options_.memory_budget / 2) return true;  // spilled by another producer
+        Buffer full;
+        std::swap(full, active_);
+        lock.unlock();
+        if (spill(full)) return true;
+        lock.lock();
+        failed_ = true;
+        return false;
+    }
+
+    // Writes the partition files once all producers are done. Returns false
+    // on an I/O error.
+    bool finish() {
+        std::lock_guard<std::mutex> spilling(spill_mutex_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (failed_) return false;
+        if (runs_.empty()) {
+            // Everything fit in memory: write the buffer out directly.
+            sort_buffer(active_);
+            MemoryRun run(active_);
+            failed_ = !write_partitions(std::vector<MemoryRun*>{&run});
+        } else {
+            failed_ = !(active_.records.empty() || spill(active_)) || !merge_runs();
+            for (const auto& run : runs_) std::remove(run.c_str());
+            runs_.clear();
+        }
+        active_ = Buffer{};
+        return !failed_;
+    }
+
+    std::string partition_path(uint32_t partition) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/part-%05u.data", partition);
+        return options_.directory + name;
+    }
+
+    size_t spills() const { return spills_; }
+
+private:
+    struct Record {
+        uint32_t partition;
+        uint32_t key_len;
+        uint32_t value_len;
+        size_t offset;  // key at arena[offset], then a NUL, then the value
+    };
+
+    struct Buffer {
+        std::string arena;
+        std::vector<Record> records;
+
+        void add(uint32_t partition, std::string_view key, std::string_view value) {
+            records.push_back(Record{partition, static_cast<uint32_t>(key.size()),
+                                     static_cast<uint32_t>(value.size()), arena.size()});
+            arena.append(key.data(), key.size());
+            arena.push_back('\0');
+            arena.append(value.data(), value.size());
+        }
+
+        size_t bytes() const { return arena.size() + records.size() * sizeof(Record); }
+        const char* key(const Record& r) const { return arena.data() + r.offset; }
+        std::string_view value(const Record& r) const {
+            return std::string_view(arena.data() + r.offset + r.key_len + 1, r.value_len);
+        }
+    };
+
+    // A sorted stream of records: the merge reads from buffers and run files alike.
+    class MemoryRun {
+    public:
+        explicit MemoryRun(const Buffer& buffer) : buffer_(buffer) {}
+        bool valid() const { return next_ < buffer_.records.size(); }
+        uint32_t partition() const { return buffer_.records[next_].partition; }
+        const char* key() const { return buffer_.key(buffer_.records[next_]); }
+        std::string_view value() const { return buffer_.value(buffer_.records[next_]); }
+        bool advance() {
+            next_++;
+            return true;
+        }
+
+    private:
+        const Buffer& buffer_;
+        size_t next_ = 0;
+    };
+
+    class FileRun {
+    public:
+        bool open(const std::string& path) {
+            in_.open(path, std::ios::binary);
+            return in_ && advance();
+        }
+        bool valid() const { return valid_; }
+        uint32_t partition() const { return partition_; }
+        const char* key() const { return key_.c_str(); }
+        std::string_view value() const { return value_; }
+
+        // Reads the next record; false on a truncated file.
+        bool advance() {
+            uint32_t header[3];
+            if (!in_.read(reinterpret_cast<char*>(header), sizeof(header))) {
+                valid_ = false;
+                return in_.gcount() == 0;
+            }
+            partition_ = header[0];
+            key_.resize(header[1]);
+            value_.resize(header[2]);
+            valid_ = in_.read(&key_[0], header[1]) && in_.read(&value_[0], header[2]);
+            return valid_;
+        }
+
+    private:
+        std::ifstream in_;
+        bool valid_ = false;
+        uint32_t partition_ = 0;
+        std::string key_, value_;
+    };
+
+    static constexpr size_t kFlushBytes = 1 << 20;  // output gathered per file write
+
+    template <typename T>
+    static void append(std::string& out, T v) {
+        out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+
+    ShuffleOptions options_;
+    std::mutex mutex_;        // guards active_ and failed_
+    std::mutex spill_mutex_;  // held while spilling; guards runs_
+    Buffer active_;
+    bool failed_ = false;
+    std::vector<std::string> runs_;
+    size_t spills_ = 0;
+
+    // Orders the records by partition (stable counting sort), then each
+    // partition by key.
+    void sort_buffer(Buffer& buffer) const {
+        TraceSpan span("shuffle sort", "shuffle", buffer.records.size());
+        std::vector<size_t> start(options_.partitions + 1, 0);
+        for (const Record& r : buffer.records) start[r.partition + 1]++;
+        for (uint32_t p = 0; p < options_.partitions; ++p) start[p + 1] += start[p];
+        std::vector<Record> ordered(buffer.records.size());
+        std::vector<size_t> next(start.begin(), start.end() - 1);
+        for (const Record& r : buffer.records) ordered[next[r.partition]++] = r;
+        buffer.records.swap(ordered);
+
+        auto key = [&buffer](const Record& r) { return buffer.key(r); };
+        for (uint32_t p = 0; p < options_.partitions; ++p) {
+            auto first = buffer.records.begin() + start[p], last = buffer.records.begin() + start[p + 1];
+            if (options_.sort_threads > 1) {
+                OptimizedOrasort::sort_parallel(first, last, key, options_.sort_threads);
+            } else {
+                OptimizedOrasort::sort(first, last, key);
+            }
+        }
+    }
+
+    // Sorts the buffer and writes it as a run file (spill_mutex_ held).
+    bool spill(Buffer& buffer) {
+        sort_buffer(buffer);
+        TraceSpan span("shuffle spill", "shuffle", buffer.bytes());
+        char name[32];
+        std::snprintf(name, sizeof(name), "/spill-%05zu.run", runs_.size());
+        const std::string path = options_.directory + name;
+        std::ofstream out(path, std::ios::binary);
+        runs_.push_back(path);
+        spills_++;
+        std::string data;
+        for (const Record& r : buffer.records) {
+            append(data, r.partition);
+            append(data, r.key_len);
+            append(data, r.value_len);
+            data.append(buffer.key(r), r.key_len);
+            data.append(buffer.value(r).data(), r.value_len);
+            if (data.size() >= kFlushBytes) {
+                out.write(data.data(), data.size());
+                data.clear();
+            }
+        }
+        out.write(data.data(), data.size());
+        buffer = Buffer{};
+        out.close();
+        return static_cast<bool>(out);
+    }
+
+    bool merge_runs() {
+        std::vector<FileRun> files(runs_.size());
+        std::vector<FileRun*> inputs;
+        for (size_t r = 0; r < runs_.size(); ++r) {
+            if (!files[r].open(runs_[r])) return false;
+            inputs.push_back(&files[r]);
+        }
+        return write_partitions(inputs);
+    }
+
+    // Merges the sorted runs into the partition files, through a heap of
+    // the runs ordered by their next record.
+    template <typename Run>
+    bool write_partitions(const std::vector<Run*>& runs) {
+        TraceSpan span("shuffle merge", "shuffle", runs.size());
+        auto after = [&runs](size_t a, size_t b) {  // heap order: true if run a comes after run b
+            if (runs[a]->partition() != runs[b]->partition()) return runs[a]->partition() > runs[b]->partition();
+            const int cmp = std::strcmp(runs[a]->key(), runs[b]->key());
+            return cmp != 0 ? cmp > 0 : a > b;
+        };
+        std::vector<size_t> heap;
+        for (size_t r = 0; r < runs.size(); ++r) {
+            if (runs[r]->valid()) heap.push_back(r);
+        }
+        std::make_heap(heap.begin(), heap.end(), after);
+
+        for (uint32_t p = 0; p < options_.partitions; ++p) {
+            PartitionFile out;
+            if (!out.open(partition_path(p), options_.index_interval)) return false;
+            while (!heap.empty() && runs[heap.front()]->partition() == p) {
+                std::pop_heap(heap.begin(), heap.end(), after);
+                Run* run = runs[heap.back()];
+                out.add(run->key(), run->value());
+                if (!run->advance()) return false;
+                if (run->valid()) {
+                    std::push_heap(heap.begin(), heap.end(), after);
+                } else {
+                    heap.pop_back();
+                }
+            }
+            if (!out.close()) return false;
+        }
+        return true;
+    }
+
+    class PartitionFile {
+    public:
+        bool open(const std::string& path, size_t interval) {
+            interval_ = std::max<size_t>(1, interval);
+            out_.open(path, std::ios::binary | std::ios::trunc);
+            return static_cast<bool>(out_);
+        }
+
+        void add(const char* key, std::string_view value) {
+            const uint32_t key_len = static_cast<uint32_t>(std::strlen(key));
+            if (records_ % interval_ == 0) {
+                append(index_, offset_);
+                append(index_, key_len);
+                index_.append(key, key_len);
+                entries_++;
+            }
+            const size_t start = data_.size();
+            append(data_, key_len);
+            append(data_, static_cast<uint32_t>(value.size()));
+            data_.append(key, key_len);
+            data_.append(value.data(), value.size());
+            offset_ += data_.size() - start;
+            records_++;
+            if (data_.size() >= kFlushBytes) flush();
+        }
+
+        bool close() {
+            flush();
+            out_.write(index_.data(), index_.size());
+            const uint64_t footer[4] = {offset_, entries_, records_, kMagic};
+            out_.write(reinterpret_cast<const char*>(footer), sizeof(footer));
+            out_.close();
+            return static_cast<bool>(out_);
+        }
+
+    private:
+        std::ofstream out_;
+        std::string data_;  // records not yet written
+        std::string index_;
+        size_t interval_ = 1;
+        uint64_t offset_ = 0, entries_ = 0, records_ = 0;
+
+        void flush() {
+            out_.write(data_.data(), data_.size());
+            data_.clear();
+        }
+    };
+};
+
+// Reads a partition file written by ShuffleWriter, in key order.
+class ShuffleReader {
+public:
+    explicit ShuffleReader(const std::string& path) : in_(path, std::ios::binary) {
+        uint64_t footer[4];
+        if (!in_.seekg(-static_cast<std::streamoff>(sizeof(footer)), std::ios::end) ||
+            !in_.read(reinterpret_cast<char*>(footer), sizeof(footer)) || footer[3] != ShuffleWriter::kMagic) {
+            in_.setstate(std::ios::failbit);
+            return;
+        }
+        end_ = footer[0];
+        records_ = footer[2];
+        std::string index(static_cast<size_t>(in_.tellg()) - sizeof(footer) - end_, '\0');
+        in_.seekg(static_cast<std::streamoff>(end_));
+        in_.read(&index[0], index.size());
+        for (size_t pos = 0, k = 0; k < footer[1]; ++k) {
+            Entry entry;
+            std::memcpy(&entry.offset, index.data() + pos, sizeof(entry.offset));
+            uint32_t key_len = 0;
+            std::memcpy(&key_len, index.data() + pos + sizeof(entry.offset), sizeof(key_len));
+            pos += sizeof(entry.offset) + sizeof(key_len);
+            entry.key.assign(index.data() + pos, key_len);
+            pos += key_len;
+            index_.push_back(std::move(entry));
+        }
+        in_.seekg(0);
+    }
+
+    bool ok() const { return static_cast<bool>(in_); }
+    uint64_t records() const { return records_; }
+
+    // Positions the reader at the first record whose key is not below key,
+    // reading from the closest indexed record before it.
+    void seek(std::string_view key) {
+        auto it = std::lower_bound(index_.begin(), index_.end(), key,
+                                   [](const Entry& e, std::string_view k) { return e.key < k; });
+        pos_ = it == index_.begin() ? 0 : std::prev(it)->offset;
+        in_.clear();
+        in_.seekg(static_cast<std::streamoff>(pos_));
+        pending_ = false;
+        std::string k, v;
+        while (next(k, v)) {
+            if (k >= key) {
+                pending_ = true;
+                pending_key_ = std::move(k);
+                pending_value_ = std::move(v);
+                return;
+            }
+        }
+    }
+
+    // Reads the next record; false at the end of the records or on a read error.
+    bool next(std::string& key, std::string& value) {
+        if (pending_) {
+            pending_ = false;
+            key = std::move(pending_key_);
+            value = std::move(pending_value_);
+            return true;
+        }
+        if (pos_ >= end_) return false;
+        uint32_t header[2];
+        if (!in_.read(reinterpret_cast<char*>(header), sizeof(header))) return false;
+        key.resize(header[0]);
+        value.resize(header[1]);
+        if (!in_.read(&key[0], header[0]) || !in_.read(&value[0], header[1])) return false;
+        pos_ += sizeof(header) + header[0] + header[1];
+        return true;
+    }
+
+private:
+    struct Entry {
+        uint64_t offset;
+        std::string key;
+    };
+
+    std::ifstream in_;
+    std::vector<Entry> index_;
+    uint64_t end_ = 0, records_ = 0, pos_ = 0;
+    bool pending_ = false;
+    std::string pending_key_, pending_value_;
+};
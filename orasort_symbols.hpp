@@ -0,0 +1,200 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "orasort2.hpp"
+#include "orasort_key.hpp"
+#include "orasort_profile.hpp"
+#include "orasort_trace.hpp"
+
+// --- Wide Symbol Keys ---
+//
+// OptimizedOrasort caches bytes. Keys made of wider symbols (UTF-16 or
+// UTF-32 text, token-ID sequences) would have to be converted to bytes
+// first, doubling the memory and the work. SymbolOrasort caches them
+// directly: a cache word packs 64 / bits symbols big endian (4 UTF-16 code
+// units, 2 UTF-32 code points or 32-bit token IDs), depth counts symbols,
+// and keys compare symbol by symbol as unsigned integers, like
+// std::u16string and std::u32string do.
+//
+// Keys are (pointer, length) sequences, so any symbol value is allowed,
+// zero included: the cache is zero padded past the end of a key and the
+// lengths decide between equal caches.
+//
+// The recursion is OptimizedOrasort's scalar one: the same Hoare partition
+// (shared as a template over the item type), and the same tuning() profile
+// for the knobs that apply to it. The byte engine's network, sample sort
+// and learned steps are built on byte alphabets and stay there.
+
+// Loads up to 64 / bits symbols into a word, first symbol in the most
+// significant bits, zero padded after the count available.
+template <typename Symbol>
+inline uint64_t load_symbols_be(const Symbol* ptr, size_t available) {
+    constexpr int bits = 8 * sizeof(Symbol);
+    constexpr size_t symbols = 64 / bits;
+    const size_t count = available < symbols ? available : symbols;
+    ORASORT_INSPECT(count * sizeof(Symbol));
+    uint64_t word = 0;
+    for (size_t k = 0; k < count; ++k) {
+        word |= static_cast<uint64_t>(ptr[k]) << (64 - bits * (k + 1));
+    }
+    return word;
+}
+
+template <typename Symbol>
+class SymbolOrasort {
+    static_assert(std::is_integral_v<Symbol> && std::is_unsigned_v<Symbol> && sizeof(Symbol) <= 8,
+                  "symbols are unsigned integers of at most 64 bits");
+
+public:
+    static constexpr int kBits = 8 * sizeof(Symbol);  // bits per symbol in the cache word
+    static constexpr int kSymbols = 64 / kBits;       // symbols held by one cache word
+
+    struct SymbolItem {
+        const Symbol* ptr;  // first symbol of the key
+        uint32_t len;       // symbols in the key
+        uint32_t index;     // position of the key's element in the input
+        uint64_t cache;     // symbols [depth, depth + kSymbols) of the key
+
+        // Depth never exceeds len: match lengths only count symbols both keys have.
+        void refresh_cache(uint32_t depth) { cache = load_symbols_be(ptr + depth, len - depth); }
+    };
+
+    // Sorts [first, last) by the symbol sequences proj projects from the
+    // elements: std::u16string, std::u32string, std::vector<uint32_t>, a
+    // basic_string_view, ... The elements are then moved into sorted order.
+    // At most 2^32 - 1 elements with keys of at most 2^32 - 1 symbols.
+    template <typename RandomIt, typename Proj = KeyIdentity, typename = enable_if_projection_t<Proj, RandomIt>>
+    static void sort(RandomIt first, RandomIt last, Proj proj = {}) {
+        using Key = projected_key_t<Proj, RandomIt>;
+        static_assert(std::is_lvalue_reference_v<Key> || std::is_trivially_copyable_v<std::decay_t<Key>>,
+                      "keys are used in place: project to a reference or a view");
+        static_assert(std::is_convertible_v<decltype(std::data(std::declval<Key>())), const Symbol*>,
+                      "keys must be contiguous sequences of the symbol type");
+        const size_t n = static_cast<size_t>(last - first);
+        if (n < 2) return;
+
+        std::vector<SymbolItem> items(n);
+        {
+            ORASORT_PHASE(CacheBuild);
+            for (size_t i = 0; i < n; ++i) {
+                const auto& key = std::invoke(proj, first[i]);
+                items[i].ptr = std::data(key);
+                items[i].len = static_cast<uint32_t>(std::size(key));
+                items[i].index = static_cast<uint32_t>(i);
+            }
+        }
+        sort_items(items);
+
+        ORASORT_PHASE(WriteBack);
+        TraceSpan span("write-back", "sort", n);
+        std::vector<size_t> order(n);
+        for (size_t k = 0; k < n; ++k) order[k] = items[k].index;
+        apply_permutation(first, order);
+    }
+
+    template <typename Range, typename Proj = KeyIdentity, typename = enable_if_range_t<Range>,
+              typename = enable_if_projection_t<Proj, decltype(std::begin(std::declval<Range&>()))>>
+    static void sort(Range& range, Proj proj = {}) {
+        sort(std::begin(range), std::end(range), proj);
+    }
+
+    // Sorts items in place by their keys (caches are built here).
+    static void sort_items(std::vector<SymbolItem>& items) {
+        if (items.size() < 2) return;
+        {
+            ORASORT_PHASE(CacheBuild);
+            for (auto& item : items) item.refresh_cache(0);
+        }
+        SymbolContext ctx;
+        sort_recursive(items.data(), 0, static_cast<int>(items.size()) - 1, 0, ctx);
+    }
+
+private:
+    // Per-sort state threaded through the recursion.
+    struct SymbolContext {
+        SortTuning tuning = OptimizedOrasort::tuning();  // copied once per sort, as OptimizedOrasort does
+        uint64_t rng = 0x9E3779B97F4A7C15ULL;            // pivot selection
+
+        int random(int range) {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            return static_cast<int>(rng % static_cast<uint64_t>(range));
+        }
+    };
+
+    // Returns <0, 0 or >0 and the number of matching symbols from depth on.
+    static int compare_and_count(const SymbolItem& a, const SymbolItem& b, uint32_t depth, uint32_t& match_len_out) {
+        ORASORT_COMPARE(1);
+        const uint32_t rem_a = a.len - depth;
+        const uint32_t rem_b = b.len - depth;
+        const uint32_t shorter = rem_a < rem_b ? rem_a : rem_b;
+
+        // 1. Fast Path: padding sorts below every symbol, so a key that is a
+        // proper prefix of the other compares lower here too.
+        if (a.cache != b.cache) {
+            const uint32_t match = static_cast<uint32_t>(__builtin_clzll(a.cache ^ b.cache) / kBits);
+            match_len_out = match < shorter ? match : shorter;
+            return (a.cache < b.cache) ? -1 : 1;
+        }
+
+        // 2. Slow Path: all cached symbols match; scan on while both keys do.
+        uint32_t k = shorter < static_cast<uint32_t>(kSymbols) ? shorter : static_cast<uint32_t>(kSymbols);
+        if (k < shorter) {
+            ORASORT_PHASE(SlowCompare);
+            const Symbol* s1 = a.ptr + depth;
+            const Symbol* s2 = b.ptr + depth;
+            while (k < shorter && s1[k] == s2[k]) k++;
+            ORASORT_INSPECT(2 * sizeof(Symbol) * (k + 1 - kSymbols));
+            match_len_out = k;
+            if (k < shorter) return (s1[k] < s2[k]) ? -1 : 1;
+        }
+        match_len_out = k;
+        return (rem_a > rem_b) - (rem_a < rem_b);
+    }
+
+    // OptimizedOrasort's Hoare partition, on symbol items.
+    static void sort_recursive(SymbolItem* arr, int low, int high, uint32_t depth, SymbolContext& ctx) {
+        if (low >= high) return;
+        ORASORT_PHASE(Partition);
+
+        const int pivot_idx = low + ctx.random(high - low + 1);
+        std::swap(arr[low], arr[pivot_idx]);
+
+        uint32_t min_common_with_pivot = UINT32_MAX;
+        const int j = OptimizedOrasort::hoare_partition_items(
+            arr, low, high, min_common_with_pivot, [&](const SymbolItem& a, const SymbolItem& b, uint32_t& match_len) {
+                return compare_and_count(a, b, depth, match_len);
+            });
+
+        if (min_common_with_pivot == UINT32_MAX) min_common_with_pivot = 0;
+        const uint32_t new_depth = depth + min_common_with_pivot;
+        recurse(arr, low, j - 1, depth, new_depth, ctx);
+        recurse(arr, j + 1, high, depth, new_depth, ctx);
+    }
+
+    static void recurse(SymbolItem* arr, int low, int high, uint32_t depth, uint32_t new_depth, SymbolContext& ctx) {
+        if (low >= high) return;
+        if (new_depth > depth) {
+            ORASORT_PHASE(RefreshCache);
+            const int distance = ctx.tuning.prefetch_distance;
+            for (int k = low; k <= high; k++) {
+                if (distance && k + distance <= high) __builtin_prefetch(arr[k + distance].ptr + new_depth);
+                arr[k].refresh_cache(new_depth);
+            }
+        }
+        sort_recursive(arr, low, high, new_depth, ctx);
+    }
+};
+
+using Utf16Orasort = SymbolOrasort<char16_t>;
+using Utf32Orasort = SymbolOrasort<char32_t>;
+using TokenOrasort = SymbolOrasort<uint32_t>;
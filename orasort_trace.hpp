@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// --- Chrome Trace Timeline ---
+//
+// Records spans (partition tasks, steals, run writes, merges, I/O waits) into
+// per-thread ring buffers and dumps them as Chrome trace JSON, viewable in
+// chrome://tracing or Perfetto. Recording is off until enabled; a disabled
+// TraceSpan costs one relaxed load. Each thread only appends to its own
+// buffer, so recording takes no locks; a full buffer overwrites its oldest
+// events. A thread's buffer is reused by a later thread once it exits, so
+// repeated parallel sorts do not grow the recorder. Dump after the traced
+// work has finished.
+class TraceRecorder {
+public:
+    struct Event {
+        const char* name;  // static strings only: events keep the pointer
+        const char* category;
+        uint64_t start_ns;
+        uint64_t duration_ns;
+        uint64_t arg;      // shown as args.n (item count, bytes, ...)
+        char phase;        // 'X' complete span, 'i' instant
+    };
+
+    static TraceRecorder& instance() {
+        static TraceRecorder recorder;
+        return recorder;
+    }
+
+    void enable(bool on = true) { enabled_.store(on, std::memory_order_relaxed); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    uint64_t now_ns() const {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch_).count());
+    }
+
+    void span(const char* name, const char* category, uint64_t start_ns, uint64_t end_ns, uint64_t arg = 0) {
+        local().push(Event{name, category, start_ns, end_ns - start_ns, arg, 'X'});
+    }
+
+    void instant(const char* name, const char* category, uint64_t arg = 0) {
+        local().push(Event{name, category, now_ns(), 0, arg, 'i'});
+    }
+
+    // Names the calling thread in the timeline.
+    void set_thread_name(const std::string& name) { local().name = name; }
+
+    // Buffers allocated so far: one per thread that traced while running at
+    // the same time as the others, not per thread ever traced.
+    size_t buffer_count() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return buffers_.size();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& buffer : buffers_) {
+            buffer->head = 0;
+            buffer->size = 0;
+        }
+    }
+
+    void write_json(std::ostream& out) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+        char line[512];
+        for (const auto& buffer : buffers_) {
+            if (!buffer->name.empty()) {
+                std::snprintf(line, sizeof(line),
+                              "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                              first ? "" : ",\n", buffer->tid, buffer->name.c_str());
+                out << line;
+                first = false;
+            }
+            const size_t capacity = buffer->events.size();
+            const size_t oldest = (buffer->head + capacity - buffer->size) % capacity;
+            for (size_t k = 0; k < buffer->size; ++k) {
+                const Event& e = buffer->events[(oldest + k) % capacity];
+                if (e.phase == 'X') {
+                    std::snprintf(line, sizeof(line),
+                                  "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                                  "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"n\":%llu}}",
+                                  first ? "" : ",\n", e.name, e.category, buffer->tid, e.start_ns / 1e3,
+                                  e.duration_ns / 1e3, static_cast<unsigned long long>(e.arg));
+                } else {
+                    std::snprintf(line, sizeof(line),
+                                  "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,"
+                                  "\"ts\":%.3f,\"args\":{\"n\":%llu}}",
+                                  first ? "" : ",\n", e.name, e.category, buffer->tid, e.start_ns / 1e3,
+                                  static_cast<unsigned long long>(e.arg));
+                }
+                out << line;
+                first = false;
+            }
+        }
+        out << "\n]}\n";
+    }
+
+    bool dump(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out) return false;
+        write_json(out);
+        return static_cast<bool>(out);
+    }
+
+private:
+    static const size_t kEventsPerThread = 1 << 16;
+
+    struct ThreadBuffer {
+        std::vector<Event> events;
+        size_t head = 0;  // next slot to write
+        size_t size = 0;  // valid events, at most events.size()
+        int tid = 0;
+        std::string name;
+
+        void push(const Event& e) {
+            events[head] = e;
+            head = (head + 1) % events.size();
+            if (size < events.size()) size++;
+        }
+    };
+
+    // Handed back to the recorder when its thread exits, so that the next
+    // new thread (a worker of the next parallel sort) reuses it.
+    struct BufferLease {
+        std::shared_ptr<ThreadBuffer> buffer;
+        ~BufferLease() {
+            if (buffer) TraceRecorder::instance().release(std::move(buffer));
+        }
+    };
+
+    std::atomic<bool> enabled_{false};
+    std::chrono::steady_clock::time_point epoch_ = std::chrono::steady_clock::now();
+    mutable std::mutex mutex_;
+    // Buffers outlive their threads so that a dump still sees finished
+    // workers; a buffer whose thread has exited goes on free_ and carries on
+    // as the next thread's timeline row.
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+    std::vector<std::shared_ptr<ThreadBuffer>> free_;
+
+    ThreadBuffer& local() {
+        thread_local BufferLease lease;
+        if (!lease.buffer) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!free_.empty()) {
+                lease.buffer = std::move(free_.back());
+                free_.pop_back();
+            } else {
+                lease.buffer = std::make_shared<ThreadBuffer>();
+                lease.buffer->events.resize(kEventsPerThread);
+                lease.buffer->tid = static_cast<int>(buffers_.size()) + 1;
+                buffers_.push_back(lease.buffer);
+            }
+        }
+        return *lease.buffer;
+    }
+
+    void release(std::shared_ptr<ThreadBuffer> buffer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(std::move(buffer));
+    }
+};
+
+// Records a span from construction to destruction when tracing is enabled.
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* category, uint64_t arg = 0)
+        : name_(name), category_(category), arg_(arg), active_(TraceRecorder::instance().enabled()) {
+        if (active_) start_ = TraceRecorder::instance().now_ns();
+    }
+    ~TraceSpan() {
+        if (active_) TraceRecorder::instance().span(name_, category_, start_, TraceRecorder::instance().now_ns(), arg_);
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name_;
+    const char* category_;
+    uint64_t arg_;
+    bool active_;
+    uint64_t start_ = 0;
+};
@@ -0,0 +1,135 @@
+// Tunes OptimizedOrasort for this machine and a sample of your data.
+//
+//   g++ -O2 -std=c++17 -pthread orasort_tune.cpp -o orasort_tune
+//   ./orasort_tune <keys file | dataset> [profile] [sample size]
+//   ORASORT_TUNING=orasort.tune ./your_program
+//
+// Each setting of the tuning profile is varied in turn, keeping the best
+// value found so far for the others (two rounds of coordinate descent). A
+// candidate's cost is the median time of five sorts of the sample. The
+// profile (default orasort.tune) is then written for OptimizedOrasort to load.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "orasort2.hpp"
+#include "orasort_datasets.hpp"
+
+namespace {
+
+struct Tuner {
+    std::vector<std::string> sample;
+    unsigned threads;
+
+    // Median time in ms of sorting the sample with the given tuning.
+    double measure(const SortTuning& tuning, bool parallel) const {
+        OptimizedOrasort::tuning() = tuning;
+        OptimizedOrasort::partition_kernel() = select_partition_kernel(tuning.kernel);
+        std::vector<double> times;
+        for (int trial = 0; trial < 5; ++trial) {
+            std::vector<StringItem> items(sample.size());
+            for (size_t i = 0; i < sample.size(); ++i) items[i].ptr = sample[i].c_str();
+            auto start = std::chrono::steady_clock::now();
+            if (parallel) {
+                OptimizedOrasort::sort_items_parallel(items, threads);
+            } else {
+                OptimizedOrasort::sort_items(items);
+            }
+            times.push_back(
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+
+    // Tries each candidate value of one setting and keeps the fastest.
+    template <typename T>
+    void sweep(SortTuning& best, double& best_ms, const char* name, T SortTuning::*field,
+               const std::vector<T>& candidates, bool parallel = false) const {
+        if (parallel) best_ms = measure(best, true);
+        for (const T& value : candidates) {
+            if (best.*field == value) continue;
+            SortTuning trial = best;
+            trial.*field = value;
+            double ms = measure(trial, parallel);
+            if (ms < best_ms) {
+                best = trial;
+                best_ms = ms;
+            }
+        }
+        if (parallel) best_ms = measure(best, false);
+        std::printf("  %-22s -> %s\n", name, to_string(best.*field).c_str());
+    }
+
+    static std::string to_string(int v) { return std::to_string(v); }
+    static std::string to_string(bool v) { return v ? "1" : "0"; }
+    static std::string to_string(const std::string& v) { return v.empty() ? "(auto)" : v; }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <keys file | dataset> [profile] [sample size]\n", argv[0]);
+        return 2;
+    }
+    const std::string source = argv[1];
+    const std::string profile = argc > 2 ? argv[2] : "orasort.tune";
+    const size_t sample_size = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 200000;
+
+    std::vector<std::string> keys = DatasetGenerator::generate(source, sample_size);
+    if (keys.empty() && !DatasetGenerator::read_keys(source, keys)) {
+        std::fprintf(stderr, "neither a dataset nor a readable file: %s\n", source.c_str());
+        return 1;
+    }
+    Tuner tuner;
+    tuner.threads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t step = std::max<size_t>(1, keys.size() / std::max<size_t>(sample_size, 1));
+    for (size_t i = 0; i < keys.size() && tuner.sample.size() < sample_size; i += step) {
+        tuner.sample.push_back(keys[i]);
+    }
+    if (tuner.sample.size() < 2) {
+        std::fprintf(stderr, "%s: too few keys to tune on\n", source.c_str());
+        return 1;
+    }
+
+    std::vector<std::string> kernels = {"scalar"};
+    if (detect_partition_kernel() >= PartitionKernel::AVX2) kernels.push_back("avx2");
+    if (detect_partition_kernel() >= PartitionKernel::AVX512) kernels.push_back("avx512");
+
+    SortTuning best;
+    double best_ms = tuner.measure(best, false);
+    std::printf("tuning on %zu keys, %u threads: default %.2f ms\n", tuner.sample.size(), tuner.threads, best_ms);
+    for (int round = 1; round <= 2; ++round) {
+        std::printf("round %d\n", round);
+        tuner.sweep(best, best_ms, "kernel", &SortTuning::kernel, kernels);
+        tuner.sweep(best, best_ms, "network_max", &SortTuning::network_max, {0, 16, 32, 64});
+        tuner.sweep(best, best_ms, "sample_sort_min", &SortTuning::sample_sort_min,
+                    {0, 1 << 10, 1 << 12, 1 << 14, 1 << 16});
+        tuner.sweep(best, best_ms, "learned_sort_min", &SortTuning::learned_sort_min,
+                    {0, 1 << 14, 1 << 16, 1 << 18});
+        tuner.sweep(best, best_ms, "vector_partition_min", &SortTuning::vector_partition_min,
+                    {16, 32, 64, 128, 256, 1024});
+        tuner.sweep(best, best_ms, "prefetch_distance", &SortTuning::prefetch_distance, {0, 2, 4, 8, 16, 32});
+        tuner.sweep(best, best_ms, "reduce_alphabet", &SortTuning::reduce_alphabet, {true, false});
+        if (tuner.threads > 1) {
+            tuner.sweep(best, best_ms, "parallel_cutoff", &SortTuning::parallel_cutoff,
+                        {1 << 11, 1 << 12, 1 << 13, 1 << 14, 1 << 15, 1 << 16, 1 << 17}, true);
+            tuner.sweep(best, best_ms, "radix_partition_min", &SortTuning::radix_partition_min,
+                        {0, 1 << 15, 1 << 17, 1 << 20}, true);
+        }
+    }
+    std::printf("tuned: %.2f ms\n", best_ms);
+
+    if (!best.save(profile)) {
+        std::fprintf(stderr, "cannot write %s\n", profile.c_str());
+        return 1;
+    }
+    std::printf("profile written to %s (load with ORASORT_TUNING=%s)\n", profile.c_str(), profile.c_str());
+    return 0;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+// --- Tuning Profile ---
+//
+// The thresholds of OptimizedOrasort depend on the cache sizes, vector width
+// and memory latency of the machine. orasort_tune measures them on a sample
+// of real data and writes a profile of "name = value" lines; OptimizedOrasort
+// loads the file named by the ORASORT_TUNING environment variable on first
+// use. Missing or unknown entries keep their defaults, so profiles written by
+// older or newer builds still load.
+struct SortTuning {
+    int vector_partition_min = 32;  // smallest partition for the SIMD three-way partition
+    int network_max = 64;           // largest partition for the sorting network (0: off, at most 64)
+    int sample_sort_min = 1 << 12;  // smallest partition split by a sample sort step (0: off)
+    int learned_sort_min = 1 << 16; // smallest partition split by a learned CDF model (0: off)
+    int parallel_cutoff = 1 << 14;  // smallest partition handed to the task pool
+    int radix_partition_min = 1 << 20;  // smallest parallel sort split first by a parallel radix pass (0: off)
+    int prefetch_distance = 0;      // items ahead whose keys are prefetched in cache refreshes (0: off)
+    bool reduce_alphabet = true;    // pack narrow alphabets into more symbols per cache word
+    std::string kernel;             // "scalar", "avx2" or "avx512"; empty picks the best supported
+
+    bool save(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out) return false;
+        out << "# orasort tuning profile\n"
+            << "vector_partition_min = " << vector_partition_min << "\n"
+            << "network_max = " << network_max << "\n"
+            << "sample_sort_min = " << sample_sort_min << "\n"
+            << "learned_sort_min = " << learned_sort_min << "\n"
+            << "parallel_cutoff = " << parallel_cutoff << "\n"
+            << "radix_partition_min = " << radix_partition_min << "\n"
+            << "prefetch_distance = " << prefetch_distance << "\n"
+            << "reduce_alphabet = " << (reduce_alphabet ? 1 : 0) << "\n"
+            << "kernel = " << kernel << "\n";
+        return static_cast<bool>(out);
+    }
+
+    bool load(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) return false;
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t eq = line.find('=');
+            if (line.empty() || line[0] == '#' || eq == std::string::npos) continue;
+            const std::string name = trim(line.substr(0, eq));
+            const std::string value = trim(line.substr(eq + 1));
+            const int number = std::atoi(value.c_str());
+            if (name == "vector_partition_min") vector_partition_min = std::max(2, number);
+            else if (name == "network_max") network_max = std::min(std::max(0, number), 64);
+            else if (name == "sample_sort_min") sample_sort_min = number > 0 ? std::max(64, number) : 0;
+            else if (name == "learned_sort_min") learned_sort_min = number > 0 ? std::max(1024, number) : 0;
+            else if (name == "parallel_cutoff") parallel_cutoff = std::max(2, number);
+            else if (name == "radix_partition_min") radix_partition_min = std::max(0, number);
+            else if (name == "prefetch_distance") prefetch_distance = std::max(0, number);
+            else if (name == "reduce_alphabet") reduce_alphabet = number != 0;
+            else if (name == "kernel") kernel = value;
+        }
+        return true;
+    }
+
+    // Defaults, overridden by the profile named in ORASORT_TUNING if any.
+    static SortTuning from_environment() {
+        SortTuning tuning;
+        const char* path = std::getenv("ORASORT_TUNING");
+        if (path) tuning.load(path);
+        return tuning;
+    }
+
+private:
+    static std::string trim(const std::string& s) {
+        size_t first = s.find_first_not_of(" \t\r");
+        if (first == std::string::npos) return "";
+        return s.substr(first, s.find_last_not_of(" \t\r") - first + 1);
+    }
+};